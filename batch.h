@@ -0,0 +1,30 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : the batch entry point of libsha256, many independent messages in one call
+ * the small messages go to the multi buffer engine (when it's faster than the single stream kernel on
+ * this cpu), the big ones to the single stream kernel one per thread, nothing has to be tuned by the caller
+*/
+
+// up to this size a message goes to the multi buffer engine, past it the lanes spend most of the time
+// waiting for the longest message of the group
+#define SHA256_BATCH_SMALL_MAX (16 * 1024)
+// small messages handed to one thread at a time
+#define SHA256_BATCH_SLICE 512
+// below this many bytes in total the threads cost more than they give
+#define SHA256_BATCH_THREADED_MIN (1024 * 1024)
+
+// Hashes n messages, msgs[i] with lens[i] bytes goes to digests[i], using every cpu, -1 if memory ran out
+SHA256_API int sha256_batch(const uint8_t *const *msgs, const size_t *lens, size_t n, uint8_t (*digests)[SHA256_DIGEST_SIZE]);
+// Same, with at most workers threads (1 keeps everything on the calling thread), -1 if memory ran out and
+// nothing was hashed, fewer threads than asked when some can't be made
+SHA256_API int sha256_batch_workers(const uint8_t *const *msgs, const size_t *lens, size_t n,
+                         uint8_t (*digests)[SHA256_DIGEST_SIZE], int workers);
+// Checks a mixed batch against sha256(), prints the result, 0 when everything matched
+int sha256_batch_self_test(void);
+#endif
@@ -0,0 +1,696 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "sha256.h"
+#include "sha256_mb.h"
+#include "hashfile.h"
+#include "gen_constants.h"
+#include "hmac.h"
+#include "sha512.h"
+#include "pool.h"
+#include "cdc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+/*
+ * File Description : benchmarks, run with make bench
+ * startup: what each invocation used to pay to build the constants (sieve, cubic roots, mallocs)
+ * against the table generated at build time, and the wall time of a hole run of the binary
+ * throughput: MB/s, cycles/byte and time per message for every kernel and input path, from 0 B to
+ * 1 GiB, the results also go to CSV and JSON files so two runs can be diffed
+ * hmac: PBKDF2 iterations per second, the midstate engine against HMAC built the naive way on the context
+ * family: SHA-512, SHA-384 and SHA-512/256 against the SHA-256 kernels on the same buffers, these rows go to
+ * the CSV and JSON too
+ * fixed: sha256_32(), sha256_64() and sha256d_64() against sha256() on the same sizes, also on the CSV and JSON
+ * cdc: content defined chunking with the digests in the same pass, against cutting everything first and
+ * hashing the chunks after, also on the CSV and JSON
+ *
+ * USAGE: bench_sha [--exe ./SHA] [--max-size SIZE] [--csv FILE] [--json FILE] [--only startup|throughput|hmac|family|fixed|cdc]
+*/
+
+// every size measured, the ones above --max-size are skipped
+static const size_t bench_sizes[] = {
+    0, 64, 256, 1024, 4096, 16384, 65536, 1 << 20, 16 << 20, 256 << 20, 1 << 30,
+};
+// the files for the mmap and streaming paths start at this size, below it the open() is all that's measured
+#define BENCH_FILE_MIN_SIZE 4096
+// the batch engines are only interesting for small messages
+#define BENCH_BATCH_MAX_SIZE 4096
+// each measurement hashes at least this many bytes (or runs this many times) to get a stable number
+#define BENCH_TARGET_BYTES (256u << 20)
+#define BENCH_MIN_ITERATIONS 3
+#define BENCH_MAX_ITERATIONS 2000000
+
+// one line of the results
+typedef struct Bench_result {
+    char kernel[24];
+    char input[16];
+    size_t size;
+    size_t iterations;
+    double seconds;
+    uint64_t cycles;
+} bench_result;
+
+typedef struct Bench_results {
+    bench_result *items;
+    size_t count;
+    size_t capacity;
+} bench_results;
+
+// so the compiler can't throw away the work being measured
+static volatile uint32_t sink;
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// the old startup, everything computed at runtime on the heap
+static void startup_runtime(void){
+    uint32_t *primes = prime_arr_generator();
+    uint32_t *K = initialize_array_of_constants(primes);
+    uint32_t *H = initialize_hash_values(primes);
+    sink ^= K[63] ^ H[7];
+    free(primes);
+    free(K);
+    free(H);
+}
+
+// the startup now, the tables are already in the binary
+static void startup_table(void){
+    sha256_ctx ctx;
+    sha256_setup();
+    sha256_init(&ctx);
+    sink ^= ctx.hash[7];
+}
+
+static void bench_startup(const char *exe){
+    const int rounds = 100000;
+
+    double start = now_seconds();
+    for(int i = 0; i < rounds; ++i){
+        startup_runtime();
+    }
+    double runtime_ns = (now_seconds() - start) * 1e9 / rounds;
+
+    start = now_seconds();
+    for(int i = 0; i < rounds; ++i){
+        startup_table();
+    }
+    double table_ns = (now_seconds() - start) * 1e9 / rounds;
+
+    printf("startup: runtime constants   %10.1f ns per invocation (4 mallocs)\n", runtime_ns);
+    printf("startup: build time table    %10.1f ns per invocation (no mallocs)\n", table_ns);
+    printf("startup: saving              %10.1f ns per invocation\n", runtime_ns - table_ns);
+
+    // a hole process, fork + exec + hashing a short string
+    if(exe == NULL || access(exe, X_OK) != 0){
+        return;
+    }
+    const int runs = 200;
+    // the children would flush what's still buffered here
+    fflush(stdout);
+    start = now_seconds();
+    for(int i = 0; i < runs; ++i){
+        pid_t pid = fork();
+        if(pid == 0){
+            // the output isn't important here
+            if(freopen("/dev/null", "w", stdout) == NULL){
+                _exit(1);
+            }
+            execl(exe, exe, "abc", (char *)NULL);
+            _exit(127);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+    }
+    printf("startup: %s abc           %10.1f us per process\n", exe, (now_seconds() - start) * 1e6 / runs);
+}
+
+// HMAC the way it's written from the RFC, both pads hashed again on every call
+static void naive_hmac(const uint8_t key_block[SHA256_BLOCK_SIZE], const uint8_t *data, size_t len, uint8_t mac[SHA256_DIGEST_SIZE]){
+    uint8_t pad[SHA256_BLOCK_SIZE];
+    uint8_t inner[SHA256_DIGEST_SIZE];
+    sha256_ctx ctx;
+
+    for(int i = 0; i < SHA256_BLOCK_SIZE; ++i){
+        pad[i] = key_block[i] ^ 0x36;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, sizeof(pad));
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, inner);
+
+    for(int i = 0; i < SHA256_BLOCK_SIZE; ++i){
+        pad[i] = key_block[i] ^ 0x5c;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, sizeof(pad));
+    sha256_update(&ctx, inner, sizeof(inner));
+    sha256_final(&ctx, mac);
+}
+
+// one 32 byte output block of PBKDF2 on top of naive_hmac(), the password fits in a block
+static void naive_pbkdf2(const char *password, const char *salt, uint32_t iterations, uint8_t out[SHA256_DIGEST_SIZE]){
+    uint8_t key_block[SHA256_BLOCK_SIZE] = {0};
+    uint8_t message[SHA256_BLOCK_SIZE];
+    uint8_t u[SHA256_DIGEST_SIZE];
+    size_t salt_len = strlen(salt);
+
+    memcpy(key_block, password, strlen(password));
+    memcpy(message, salt, salt_len);
+    memcpy(&message[salt_len], "\0\0\0\1", 4);
+    naive_hmac(key_block, message, salt_len + 4, u);
+    memcpy(out, u, sizeof(u));
+    for(uint32_t j = 1; j < iterations; ++j){
+        naive_hmac(key_block, u, sizeof(u), u);
+        for(int i = 0; i < SHA256_DIGEST_SIZE; ++i){
+            out[i] ^= u[i];
+        }
+    }
+}
+
+static void bench_hmac(void){
+    const uint32_t iterations = 200000;
+    uint8_t naive[SHA256_DIGEST_SIZE];
+    uint8_t engine[SHA256_DIGEST_SIZE];
+
+    double start = now_seconds();
+    naive_pbkdf2("password", "salt", iterations, naive);
+    double naive_s = now_seconds() - start;
+
+    start = now_seconds();
+    pbkdf2_hmac_sha256("password", 8, "salt", 4, iterations, engine, sizeof(engine), 1);
+    double engine_s = now_seconds() - start;
+
+    if(memcmp(naive, engine, sizeof(engine)) != 0){
+        printf("hmac: the naive and the midstate PBKDF2 don't agree\n");
+        return;
+    }
+    printf("hmac: pbkdf2 naive                %12.0f iterations/s\n", iterations / naive_s);
+    printf("hmac: pbkdf2 midstates            %12.0f iterations/s (%.2fx)\n", iterations / engine_s, naive_s / engine_s);
+
+    // a key longer than one output block, the blocks go to every worker
+    int workers = pool_default_workers();
+    size_t blocks = workers < 4 ? 4 : (size_t)workers;
+    uint8_t *derived = malloc(blocks * SHA256_DIGEST_SIZE);
+    if(derived == NULL){
+        perror("malloc failed, in function bench_hmac");
+        exit(1);
+    }
+    start = now_seconds();
+    pbkdf2_hmac_sha256("password", 8, "salt", 4, iterations, derived, blocks * SHA256_DIGEST_SIZE, workers);
+    double threads_s = now_seconds() - start;
+    printf("hmac: pbkdf2 %zu blocks, %2d workers %12.0f iterations/s\n", blocks, workers, blocks * iterations / threads_s);
+    free(derived);
+}
+
+// the time stamp counter, 0 where there isn't one
+static uint64_t read_cycles(void){
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void results_add(bench_results *results, const bench_result *result){
+    if(results->count >= results->capacity){
+        results->capacity = results->capacity ? results->capacity * 2 : 64;
+        results->items = realloc(results->items, results->capacity * sizeof(bench_result));
+        if(results->items == NULL){
+            perror("REALLOC FAILED IN FUNCTION results_add");
+            exit(1);
+        }
+    }
+    results->items[results->count++] = *result;
+}
+
+static double result_mb_per_s(const bench_result *r){
+    return r->seconds > 0 ? (double)r->size * r->iterations / r->seconds / 1e6 : 0;
+}
+
+static double result_cycles_per_byte(const bench_result *r){
+    return r->size > 0 && r->cycles > 0 ? (double)r->cycles / ((double)r->size * r->iterations) : 0;
+}
+
+static double result_ns_per_message(const bench_result *r){
+    return r->iterations > 0 ? r->seconds * 1e9 / r->iterations : 0;
+}
+
+static void result_print(const bench_result *r){
+    printf("%-12s %-10s %12zu %10zu %12.1f %10.2f %14.1f\n", r->kernel, r->input, r->size, r->iterations,
+           result_mb_per_s(r), result_cycles_per_byte(r), result_ns_per_message(r));
+}
+
+// how many times a message of size bytes is hashed
+static size_t iterations_for(size_t size){
+    size_t iterations = size > 0 ? BENCH_TARGET_BYTES / size : BENCH_MAX_ITERATIONS;
+    if(iterations < BENCH_MIN_ITERATIONS){
+        iterations = BENCH_MIN_ITERATIONS;
+    }
+    if(iterations > BENCH_MAX_ITERATIONS){
+        iterations = BENCH_MAX_ITERATIONS;
+    }
+    return iterations;
+}
+
+// the ways a message gets to the hasher
+enum { INPUT_HEAP, INPUT_MMAP, INPUT_STREAM, INPUT_BATCH };
+static const char *input_names[] = { "heap", "mmap", "streaming", "batch" };
+
+// writes a file with size bytes of data, for the mmap and streaming paths
+static int make_file(char *path, const uint8_t *data, size_t size){
+    int fd = mkstemp(path);
+    if(fd < 0){
+        perror("mkstemp failed, in function make_file");
+        return -1;
+    }
+    size_t written = 0;
+    while(written < size){
+        ssize_t n = write(fd, &data[written], size - written);
+        if(n <= 0){
+            perror("write failed, in function make_file");
+            close(fd);
+            unlink(path);
+            return -1;
+        }
+        written += (size_t)n;
+    }
+    close(fd);
+    return 0;
+}
+
+// one measurement, the kernel has to be selected already
+static void bench_one(bench_results *results, const char *kernel, int input, const uint8_t *data, size_t size, const char *path){
+    bench_result r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.kernel, sizeof(r.kernel), "%s", kernel);
+    snprintf(r.input, sizeof(r.input), "%s", input_names[input]);
+    r.size = size;
+    r.iterations = iterations_for(size);
+
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    const uint8_t **msgs = NULL;
+    size_t *lens = NULL;
+    uint8_t (*digests)[SHA256_DIGEST_SIZE] = NULL;
+    if(input == INPUT_BATCH){
+        // every message is the same buffer, the engine doesn't care
+        msgs = malloc(r.iterations * sizeof(uint8_t *));
+        lens = malloc(r.iterations * sizeof(size_t));
+        digests = malloc(r.iterations * SHA256_DIGEST_SIZE);
+        if(msgs == NULL || lens == NULL || digests == NULL){
+            perror("malloc failed, in function bench_one");
+            exit(1);
+        }
+        for(size_t i = 0; i < r.iterations; ++i){
+            msgs[i] = data;
+            lens[i] = size;
+        }
+    }
+
+    double start = now_seconds();
+    uint64_t cycles = read_cycles();
+    switch(input){
+        case INPUT_HEAP:
+            for(size_t i = 0; i < r.iterations; ++i){
+                sha256(data, size, digest);
+            }
+            break;
+        case INPUT_MMAP:
+            for(size_t i = 0; i < r.iterations; ++i){
+                hash_file_mapped(path, digest);
+            }
+            break;
+        case INPUT_STREAM:
+            for(size_t i = 0; i < r.iterations; ++i){
+                hash_file(path, digest);
+            }
+            break;
+        case INPUT_BATCH:
+            sha256_mb_hash(msgs, lens, r.iterations, digests);
+            digest[0] = digests[0][0];
+            break;
+    }
+    r.cycles = read_cycles() - cycles;
+    r.seconds = now_seconds() - start;
+    sink ^= digest[0];
+
+    free(msgs);
+    free(lens);
+    free(digests);
+    results_add(results, &r);
+    result_print(&r);
+}
+
+// one algorithm of the family on a heap buffer, -1 as variant is SHA-256 with the selected kernel
+static void bench_family_one(bench_results *results, const char *name, int variant, const uint8_t *data, size_t size){
+    bench_result r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.kernel, sizeof(r.kernel), "%s", name);
+    snprintf(r.input, sizeof(r.input), "%s", input_names[INPUT_HEAP]);
+    r.size = size;
+    r.iterations = iterations_for(size);
+
+    uint8_t digest[SHA512_DIGEST_SIZE];
+    double start = now_seconds();
+    uint64_t cycles = read_cycles();
+    for(size_t i = 0; i < r.iterations; ++i){
+        if(variant < 0){
+            sha256(data, size, digest);
+        }else{
+            sha512((sha512_variant)variant, data, size, digest);
+        }
+    }
+    r.cycles = read_cycles() - cycles;
+    r.seconds = now_seconds() - start;
+    sink ^= digest[0];
+
+    results_add(results, &r);
+    result_print(&r);
+}
+
+// the sizes where the block size and the word size matter, the small ones are all padding
+static void bench_family(bench_results *results, size_t max_size){
+    static const size_t sizes[] = { 64, 1024, 65536, 1 << 20, 16 << 20 };
+    size_t biggest = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    uint8_t *data = malloc(biggest);
+    if(data == NULL){
+        perror("malloc failed, in function bench_family");
+        exit(1);
+    }
+    for(size_t i = 0; i < biggest; ++i){
+        data[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+
+    printf("%-12s %-10s %12s %10s %12s %10s %14s\n", "algorithm", "input", "bytes", "iterations", "MB/s", "cycles/B", "ns/message");
+    sha256_kernel saved = sha256_current_kernel();
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i){
+        if(sizes[i] > max_size){
+            continue;
+        }
+        for(int k = SHA256_KERNEL_SCALAR; k <= SHA256_KERNEL_SHANI; ++k){
+            if(sha256_select_kernel((sha256_kernel)k) != 0){
+                continue;
+            }
+            char name[24];
+            snprintf(name, sizeof(name), "sha256-%s", sha256_kernel_name((sha256_kernel)k));
+            bench_family_one(results, name, -1, data, sizes[i]);
+        }
+        sha256_select_kernel(saved);
+        for(int v = SHA512_VARIANT_512; v <= SHA512_VARIANT_512_256; ++v){
+            bench_family_one(results, sha512_variant_name((sha512_variant)v), v, data, sizes[i]);
+        }
+    }
+    free(data);
+}
+
+// the ways of hashing a 32 or 64 byte input
+enum { FIXED_GENERIC_32, FIXED_32, FIXED_GENERIC_64, FIXED_64, FIXED_GENERIC_D64, FIXED_D64 };
+static const char *fixed_names[] = { "generic", "fixed", "generic", "fixed", "generic-2x", "sha256d_64" };
+static const size_t fixed_sizes[] = { 32, 32, 64, 64, 64, 64 };
+
+static void bench_fixed(bench_results *results){
+    const size_t iterations = 4000000;
+    uint8_t input[64];
+    for(int i = 0; i < 64; ++i){
+        input[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    printf("%-12s %-10s %12s %10s %12s %10s %14s\n", "kernel", "path", "bytes", "iterations", "MB/s", "cycles/B", "ns/message");
+    sha256_kernel saved = sha256_current_kernel();
+    for(int k = SHA256_KERNEL_SCALAR; k <= SHA256_KERNEL_SHANI; ++k){
+        if(sha256_select_kernel((sha256_kernel)k) != 0){
+            continue;
+        }
+        for(int path = FIXED_GENERIC_32; path <= FIXED_D64; ++path){
+            bench_result r;
+            memset(&r, 0, sizeof(r));
+            snprintf(r.kernel, sizeof(r.kernel), "%s", sha256_kernel_name((sha256_kernel)k));
+            snprintf(r.input, sizeof(r.input), "%s", fixed_names[path]);
+            r.size = fixed_sizes[path];
+            r.iterations = iterations;
+
+            // every output is the next input, so the calls can't overlap or be skipped
+            uint8_t digest[SHA256_DIGEST_SIZE];
+            double start = now_seconds();
+            uint64_t cycles = read_cycles();
+            for(size_t i = 0; i < iterations; ++i){
+                switch(path){
+                    case FIXED_GENERIC_32: sha256(input, 32, digest); break;
+                    case FIXED_32:         sha256_32(input, digest); break;
+                    case FIXED_GENERIC_64: sha256(input, 64, digest); break;
+                    case FIXED_64:         sha256_64(input, digest); break;
+                    case FIXED_GENERIC_D64:
+                        sha256(input, 64, digest);
+                        sha256(digest, SHA256_DIGEST_SIZE, digest);
+                        break;
+                    case FIXED_D64:        sha256d_64(input, digest); break;
+                }
+                memcpy(input, digest, SHA256_DIGEST_SIZE);
+            }
+            r.cycles = read_cycles() - cycles;
+            r.seconds = now_seconds() - start;
+            sink ^= digest[0];
+            results_add(results, &r);
+            result_print(&r);
+        }
+    }
+    sha256_select_kernel(saved);
+}
+
+// the ways of getting the chunk digests of a buffer
+enum { CDC_TWO_PASS, CDC_ONE_WORKER, CDC_WORKERS };
+static const char *cdc_names[] = { "two-pass", "one-pass", "workers" };
+
+static void bench_cdc(bench_results *results, size_t max_size){
+    size_t size = max_size < (64u << 20) ? max_size : (64u << 20);
+    if(size < CDC_MAX_SIZE){
+        size = CDC_MAX_SIZE;
+    }
+    uint8_t *data = malloc(size);
+    cdc_chunk *cuts = malloc((size / CDC_MIN_SIZE + 1) * sizeof(cdc_chunk));
+    if(data == NULL || cuts == NULL){
+        perror("malloc failed, in function bench_cdc");
+        exit(1);
+    }
+    // the cuts need data that looks random, a counter pattern would never cut before the max
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for(size_t i = 0; i < size; ++i){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = (uint8_t)(state >> 32);
+    }
+    cdc_params params;
+    cdc_default_params(&params);
+    int workers = pool_default_workers();
+
+    printf("%-12s %-10s %12s %10s %12s %10s %14s\n", "chunking", "path", "bytes", "iterations", "MB/s", "cycles/B", "ns/message");
+    for(int path = CDC_TWO_PASS; path <= CDC_WORKERS; ++path){
+        bench_result r;
+        memset(&r, 0, sizeof(r));
+        snprintf(r.kernel, sizeof(r.kernel), "cdc-j%d", path == CDC_WORKERS ? workers : 1);
+        snprintf(r.input, sizeof(r.input), "%s", cdc_names[path]);
+        r.size = size;
+        r.iterations = BENCH_MIN_ITERATIONS;
+
+        double start = now_seconds();
+        uint64_t cycles = read_cycles();
+        for(size_t i = 0; i < r.iterations; ++i){
+            cdc_chunk *chunks = cuts;
+            size_t count = 0;
+            if(path == CDC_TWO_PASS){
+                // the way it's done with a separate chunker, every chunk is read again from memory
+                for(size_t offset = 0; offset < size; offset += chunks[count++].length){
+                    chunks[count].offset = offset;
+                    chunks[count].length = (uint32_t)cdc_next_cut(&data[offset], size - offset, &params);
+                }
+                for(size_t c = 0; c < count; ++c){
+                    sha256(&data[chunks[c].offset], chunks[c].length, chunks[c].digest);
+                }
+            }else if(cdc_hash_buffer(data, size, &params, path == CDC_WORKERS ? workers : 1, &chunks, &count) != 0){
+                fprintf(stderr, "cdc_hash_buffer failed\n");
+                exit(1);
+            }
+            sink ^= chunks[count - 1].digest[0];
+            if(chunks != cuts){
+                free(chunks);
+            }
+        }
+        r.cycles = read_cycles() - cycles;
+        r.seconds = now_seconds() - start;
+        results_add(results, &r);
+        result_print(&r);
+    }
+    free(data);
+    free(cuts);
+}
+
+static void bench_throughput(bench_results *results, size_t max_size){
+    size_t biggest = 0;
+    for(size_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); ++i){
+        if(bench_sizes[i] <= max_size && bench_sizes[i] > biggest){
+            biggest = bench_sizes[i];
+        }
+    }
+    uint8_t *data = malloc(biggest ? biggest : 1);
+    if(data == NULL){
+        perror("malloc failed, in function bench_throughput");
+        exit(1);
+    }
+    for(size_t i = 0; i < biggest; ++i){
+        data[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+
+    printf("%-12s %-10s %12s %10s %12s %10s %14s\n", "kernel", "input", "bytes", "iterations", "MB/s", "cycles/B", "ns/message");
+    sha256_kernel saved = sha256_current_kernel();
+    for(size_t i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); ++i){
+        size_t size = bench_sizes[i];
+        if(size > max_size){
+            continue;
+        }
+
+        // one file per size, shared by every kernel, it stays on the page cache
+        char path[] = "/tmp/bench_sha_XXXXXX";
+        int have_file = size >= BENCH_FILE_MIN_SIZE && make_file(path, data, size) == 0;
+
+        for(int k = SHA256_KERNEL_SCALAR; k <= SHA256_KERNEL_SHANI; ++k){
+            if(sha256_select_kernel((sha256_kernel)k) != 0){
+                continue;
+            }
+            const char *name = sha256_kernel_name((sha256_kernel)k);
+            bench_one(results, name, INPUT_HEAP, data, size, NULL);
+            if(have_file){
+                bench_one(results, name, INPUT_MMAP, data, size, path);
+                bench_one(results, name, INPUT_STREAM, data, size, path);
+            }
+        }
+        sha256_select_kernel(saved);
+
+        // the multi buffer engines, with many messages of this size
+        if(size <= BENCH_BATCH_MAX_SIZE){
+            int saved_lanes = sha256_mb_lanes();
+            static const int engines[] = { 8, 16 };
+            for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e){
+                if(sha256_mb_select(engines[e]) == 0){
+                    bench_one(results, sha256_mb_name(), INPUT_BATCH, data, size, NULL);
+                }
+            }
+            sha256_mb_select(saved_lanes);
+        }
+
+        if(have_file){
+            unlink(path);
+        }
+    }
+    free(data);
+}
+
+static int write_csv(const bench_results *results, const char *name){
+    FILE *file = fopen(name, "w");
+    if(file == NULL){
+        perror("fopen failed, in function write_csv");
+        return -1;
+    }
+    fprintf(file, "kernel,input,bytes,iterations,seconds,mb_per_s,cycles_per_byte,ns_per_message\n");
+    for(size_t i = 0; i < results->count; ++i){
+        const bench_result *r = &results->items[i];
+        fprintf(file, "%s,%s,%zu,%zu,%.9f,%.3f,%.4f,%.1f\n", r->kernel, r->input, r->size, r->iterations,
+                r->seconds, result_mb_per_s(r), result_cycles_per_byte(r), result_ns_per_message(r));
+    }
+    fclose(file);
+    return 0;
+}
+
+static int write_json(const bench_results *results, const char *name){
+    FILE *file = fopen(name, "w");
+    if(file == NULL){
+        perror("fopen failed, in function write_json");
+        return -1;
+    }
+    fprintf(file, "[\n");
+    for(size_t i = 0; i < results->count; ++i){
+        const bench_result *r = &results->items[i];
+        fprintf(file, "  {\"kernel\": \"%s\", \"input\": \"%s\", \"bytes\": %zu, \"iterations\": %zu, "
+                      "\"seconds\": %.9f, \"mb_per_s\": %.3f, \"cycles_per_byte\": %.4f, \"ns_per_message\": %.1f}%s\n",
+                r->kernel, r->input, r->size, r->iterations, r->seconds, result_mb_per_s(r),
+                result_cycles_per_byte(r), result_ns_per_message(r), i + 1 < results->count ? "," : "");
+    }
+    fprintf(file, "]\n");
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char *argv[]){
+    // the binary to time the process startup, the Makefile passes ./SHA
+    const char *exe = NULL;
+    const char *csv = NULL;
+    const char *json = NULL;
+    const char *only = NULL;
+    size_t max_size = (size_t)1 << 30;
+
+    for(int i = 1; i < argc; ++i){
+        if(i + 1 < argc && strcmp(argv[i], "--exe") == 0){
+            exe = argv[++i];
+        }else if(i + 1 < argc && strcmp(argv[i], "--csv") == 0){
+            csv = argv[++i];
+        }else if(i + 1 < argc && strcmp(argv[i], "--json") == 0){
+            json = argv[++i];
+        }else if(i + 1 < argc && strcmp(argv[i], "--only") == 0){
+            only = argv[++i];
+        }else if(i + 1 < argc && strcmp(argv[i], "--max-size") == 0){
+            char *end = NULL;
+            max_size = strtoull(argv[++i], &end, 10);
+            switch(*end){
+                case 'K': max_size <<= 10; break;
+                case 'M': max_size <<= 20; break;
+                case 'G': max_size <<= 30; break;
+            }
+        }else{
+            fprintf(stderr, "USAGE: %s [--exe ./SHA] [--max-size SIZE] [--csv FILE] [--json FILE] [--only startup|throughput|hmac|family|fixed|cdc]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    sha256_setup();
+    if(only == NULL || strcmp(only, "startup") == 0){
+        bench_startup(exe);
+    }
+
+    bench_results results = { NULL, 0, 0 };
+    if(only == NULL || strcmp(only, "throughput") == 0){
+        bench_throughput(&results, max_size);
+    }
+
+    if(only == NULL || strcmp(only, "hmac") == 0){
+        bench_hmac();
+    }
+    if(only == NULL || strcmp(only, "family") == 0){
+        bench_family(&results, max_size);
+    }
+    if(only == NULL || strcmp(only, "fixed") == 0){
+        bench_fixed(&results);
+    }
+    if(only == NULL || strcmp(only, "cdc") == 0){
+        bench_cdc(&results, max_size);
+    }
+
+    int failed = 0;
+    if(csv != NULL && write_csv(&results, csv) != 0){
+        failed = 1;
+    }
+    if(json != NULL && write_json(&results, json) != 0){
+        failed = 1;
+    }
+    free(results.items);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,4 +1,15 @@
 #include "buffer.h"
+#include "sha256.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BUFFER_HAVE_X86 1
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 /*
  * Author : Pedro Haro
@@ -43,6 +54,9 @@ buf_t *initBuf(const char *filename){
     }
 
     buf->file_size = 0;
+    buf->mapped = 0;
+    buf->arena = NULL;
+    buf->indexed = 0;
     return buf;
 }
 
@@ -81,6 +95,20 @@ void freeBuf(buf_t* buf){
         printf("NO BUFFER TO FREE\n");
         return;
     }
+#ifndef _WIN32
+    // a mapped buffer has a single line, that belongs to the kernel
+    if(buf->mapped){
+        if(buf->lines[0].content != NULL){
+            munmap(buf->lines[0].content, buf->file_size);
+        }
+        buf->line_count = 0;
+    }
+#endif
+    // the lines of an arena are only pointers into it
+    if(buf->arena){
+        free(buf->arena);
+        buf->line_count = 0;
+    }
     // Freeing each line of the buffer
     for(size_t i = 0; i < buf->line_count; ++i){
         free(buf->lines[i].content);
@@ -186,20 +214,226 @@ void readFile(buf_t* buf, int option){
     fclose(file);
 }
 
+// one allocation and one fread for the hole file, instead of a getline and a strdup per line
+int loadFile(buf_t *buf){
+    if(buf == NULL){
+        printf("NO BUFFER TO WRITE TO\n");
+        return -1;
+    }
+
+    FILE *file = fopen(buf->filename, "rb");
+    if(file == NULL){
+        perror("ERROR OPENING FILE");
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    rewind(file);
+    if(end < 0){
+        perror("ftell failed at loadFile func");
+        fclose(file);
+        return -1;
+    }
+    size_t size = (size_t)end;
+
+    // the '\0' after the last byte ends the last line, even when it has no '\n'
+    char *arena = malloc(size + 1);
+    if(arena == NULL){
+        perror("FAILED TO ALLOCATE MEMORY FOR THE ARENA");
+        fclose(file);
+        exit(1);
+    }
+    if(fread(arena, 1, size, file) != size){
+        perror("fread failed at loadFile func");
+        free(arena);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    arena[size] = '\0';
+
+    buf->arena = arena;
+    buf->file_size = size;
+    buf->line_count = 0;
+    buf->indexed = 0;
+    return 0;
+}
+
+// Reads a stream that can't be measured first (stdin, a pipe) into an arena, growing it by doubling,
+// the lines are found later like the ones of loadFile()
+buf_t *buf_from_FILE(FILE *fp){
+    if(fp == NULL){
+        return NULL;
+    }
+    size_t capacity = 64 * 1024;
+    size_t size = 0;
+    char *arena = malloc(capacity);
+    if(arena == NULL){
+        perror("FAILED TO ALLOCATE MEMORY FOR THE ARENA");
+        exit(1);
+    }
+    size_t read;
+    // one byte is always left for the '\0'
+    while((read = fread(&arena[size], 1, capacity - size - 1, fp)) > 0){
+        size += read;
+        if(size + 1 == capacity){
+            capacity *= 2;
+            char *grown = realloc(arena, capacity);
+            if(grown == NULL){
+                perror("REALLOC FAILED IN FUNCTION buf_from_FILE(FILE *fp)");
+                exit(1);
+            }
+            arena = grown;
+        }
+    }
+    if(ferror(fp)){
+        perror("fread failed at buf_from_FILE func");
+        free(arena);
+        return NULL;
+    }
+    arena[size] = '\0';
+
+    buf_t *buf = initBuf(NULL);
+    buf->arena = arena;
+    buf->file_size = size;
+    return buf;
+}
+
+#ifdef BUFFER_HAVE_X86
+// 32 bytes compared per instruction, the bits of the mask are the '\n'
+__attribute__((target("avx2,popcnt")))
+static size_t count_newlines_avx2(const char *data, size_t size){
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0, i = 0;
+    for(; i + 32 <= size; i += 32){
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)&data[i]);
+        count += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+    }
+    for(; i < size; ++i){
+        count += data[i] == '\n';
+    }
+    return count;
+}
+#endif
+
+// how many '\n' there are, so the index is allocated once
+static size_t count_newlines(const char *data, size_t size){
+#ifdef BUFFER_HAVE_X86
+    if(__builtin_cpu_supports("avx2")){
+        return count_newlines_avx2(data, size);
+    }
+#endif
+    size_t count = 0;
+    const char *end = data + size;
+    while((data = memchr(data, '\n', end - data)) != NULL){
+        count++;
+        data++;
+    }
+    return count;
+}
+
+void indexLines(buf_t *buf){
+    if(buf == NULL || buf->arena == NULL || buf->indexed){
+        return;
+    }
+    const char *data = buf->arena;
+    size_t size = buf->file_size;
+
+    // a last line without '\n' is a line too
+    size_t count = count_newlines(data, size);
+    if(size > 0 && data[size - 1] != '\n'){
+        count++;
+    }
+    line_t *lines = realloc(buf->lines, sizeof(line_t) * (count ? count : 1));
+    if(lines == NULL){
+        perror("REALLOC FAILED IN FUNCTION indexLines(buf_t* buf)\n");
+        exit(1);
+    }
+
+    // each line keeps its '\n', like the ones from getline
+    size_t start = 0;
+    for(size_t i = 0; i < count; ++i){
+        const char *newline = memchr(&data[start], '\n', size - start);
+        size_t end = newline ? (size_t)(newline - data) + 1 : size;
+        lines[i].content = buf->arena + start;
+        lines[i].line_size = end - start;
+        lines[i].line_number = i + 1;
+        start = end;
+    }
+
+    buf->lines = lines;
+    buf->line_count = count;
+    buf->capacity = count ? count : 1;
+    buf->indexed = 1;
+}
+
+// Maps the hole file in the same layout as the binary mode of readFile, but read only and straight
+// from the page cache, so nothing is copied
+int mapFile(buf_t *buf){
+    if(buf == NULL){
+        printf("NO BUFFER TO WRITE TO\n");
+        return -1;
+    }
+#ifdef _WIN32
+    return -1;
+#else
+    int fd = open(buf->filename, O_RDONLY);
+    if(fd < 0){
+        perror("ERROR OPENING FILE");
+        return -1;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+
+    // an empty file can't be mapped, but there is nothing to map either
+    char *content = NULL;
+    if(size > 0){
+        content = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(content == MAP_FAILED){
+            perror("mmap failed at mapFile func");
+            close(fd);
+            return -1;
+        }
+        // the pages are read once, from start to end
+        madvise(content, size, MADV_SEQUENTIAL);
+    }
+    // the mapping stays valid after the fd is closed
+    close(fd);
+
+    buf->lines[0].content = content;
+    buf->lines[0].line_size = size;
+    buf->lines[0].line_number = 1;
+
+    buf->line_count = 1;
+    buf->capacity = 1;
+    buf->file_size = size;
+    buf->mapped = 1;
+    return 0;
+#endif
+}
+
 // Debug purpose - printing the contents of the buffer
 void printFile(buf_t* buf, int option){
     if(buf == NULL){
         printf("NO BUFFER TO PRINT\n");
         return;
     }
+    indexLines(buf);
+    // the lines are written by their size, the ones on an arena don't end in '\0'
     // if option is 0, going to print without numbers
     if(option==0){
         for(size_t i = 0; i < buf->line_count; ++i) {
-            printf("%s", buf->lines[i].content);
+            fwrite(buf->lines[i].content, 1, buf->lines[i].line_size, stdout);
         }
     }else if(option==1){
         for(size_t i = 0; i < buf->line_count; ++i) {
-            printf("%d  %s", buf->lines[i].line_number, buf->lines[i].content);
+            printf("%d  ", buf->lines[i].line_number);
+            fwrite(buf->lines[i].content, 1, buf->lines[i].line_size, stdout);
         }
     }
 }
@@ -213,6 +447,7 @@ void writeFile(buf_t *buf, const char *new_name) {
         return;
     }
 
+    indexLines(buf);
     // writing
     for(size_t i = 0; i < buf->line_count; ++i){
         line_t *line = &buf->lines[i];
@@ -223,6 +458,7 @@ void writeFile(buf_t *buf, const char *new_name) {
 
 // returning the amount of lines on the buffer
 int returnLines(buf_t *buf){
+    indexLines(buf);
     return buf->line_count;
 }
 
@@ -247,6 +483,7 @@ size_t returnSize(buf_t *buf){
 } */
 
 char buffer_next(buf_t *buf){
+    indexLines(buf);
     // in case buffer doesn't exist, or the cursor doesn't exist, or the amount of columns are larger the the line counter
     if(!buf || buf->cursor.current_y >= buf->line_count){
         return '\0';
@@ -283,6 +520,7 @@ char buffer_peek(buf_t *buf) {
     if(!buf){
         return '\0';
     }
+    indexLines(buf);
 
     // not effecting the position, just using temporary variables for the reason
     size_t temp_x = buf->cursor.current_x;
@@ -320,6 +558,7 @@ char buffer_peek_behind(buf_t *buf) {
     if(!buf){
         return '\0';
     }
+    indexLines(buf);
 
     size_t temp_x = buf->cursor.current_x;
     size_t temp_y = buf->cursor.current_y;
@@ -341,3 +580,162 @@ char buffer_peek_behind(buf_t *buf) {
     return '\0';
 }
 
+
+// the cursor functions give one char per call, this gives everything that's contiguous at once
+int buffer_next_span(buf_t *buf, buf_span *span){
+    if(!buf){
+        return 0;
+    }
+    indexLines(buf);
+    // skipping the lines the cursor already finished, and the empty ones
+    while(buf->cursor.current_y < buf->line_count &&
+          buf->cursor.current_x >= buf->lines[buf->cursor.current_y].line_size){
+        buf->cursor.current_y++;
+        buf->cursor.current_x = 0;
+    }
+    if(buf->cursor.current_y >= buf->line_count){
+        return 0;
+    }
+
+    line_t *line = &buf->lines[buf->cursor.current_y];
+    span->ptr = &line->content[buf->cursor.current_x];
+    span->len = line->line_size - buf->cursor.current_x;
+
+    // the next lines join the span while they start right where it ends
+    size_t y = buf->cursor.current_y + 1;
+    while(y < buf->line_count && buf->lines[y].content == span->ptr + span->len){
+        span->len += buf->lines[y].line_size;
+        y++;
+    }
+
+    // the cursor ends on the end of the last line taken
+    buf->cursor.current_y = y - 1;
+    buf->cursor.current_x = buf->lines[y - 1].line_size;
+    return 1;
+}
+
+void buffer_blocks_begin(buf_block_iter *it, buf_t *buf){
+    it->buf = buf;
+    it->span.ptr = NULL;
+    it->span.len = 0;
+    it->staged = 0;
+}
+
+size_t buffer_blocks_next(buf_block_iter *it, const char **blocks){
+    for(;;){
+        // as many whole blocks as the run has, unless one is already half staged
+        if(it->staged == 0 && it->span.len >= BUF_BLOCK_SIZE){
+            size_t n = it->span.len / BUF_BLOCK_SIZE;
+            *blocks = it->span.ptr;
+            it->span.ptr += n * BUF_BLOCK_SIZE;
+            it->span.len -= n * BUF_BLOCK_SIZE;
+            return n;
+        }
+
+        // the run ends before the block does, its end goes to the staging block
+        size_t take = BUF_BLOCK_SIZE - it->staged;
+        if(take > it->span.len){
+            take = it->span.len;
+        }
+        if(take > 0){
+            memcpy(&it->staging[it->staged], it->span.ptr, take);
+            it->staged += take;
+            it->span.ptr += take;
+            it->span.len -= take;
+        }
+        if(it->staged == BUF_BLOCK_SIZE){
+            it->staged = 0;
+            *blocks = it->staging;
+            return 1;
+        }
+
+        // only reached when the run is over
+        if(!buffer_next_span(it->buf, &it->span)){
+            return 0;
+        }
+    }
+}
+
+size_t buffer_blocks_tail(buf_block_iter *it, const char **tail){
+    *tail = it->staging;
+    return it->staged;
+}
+
+// the block walk of a buffer whose lines are scattered: runs of lines next to each other in memory, gaps
+// between the runs, empty lines, a walk from the start and one from the middle of a line, the blocks and the
+// tail fed to a context must give the SHA-256 of the flat bytes
+int buffer_blocks_self_test(void){
+    const size_t line_count = 600;
+    line_t *lines = malloc(sizeof(line_t) * line_count);
+    // every line has room for 200 bytes, with 16 more of gap when the line ends a run
+    char *backing = malloc(line_count * (200 + 16));
+    char *flat = malloc(line_count * 200);
+    if(lines == NULL || backing == NULL || flat == NULL){
+        perror("malloc failed, in function buffer_blocks_self_test");
+        exit(1);
+    }
+    uint64_t state = 0x853c49e6748fea9bULL;
+    size_t at = 0, flat_len = 0;
+    for(size_t i = 0; i < line_count; ++i){
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        size_t size = (size_t)(state >> 33) % 200;
+        if(i % 17 == 0){
+            size = 0;
+        }
+        lines[i].content = &backing[at];
+        lines[i].line_size = size;
+        lines[i].line_number = (int)i + 1;
+        for(size_t b = 0; b < size; ++b){
+            backing[at + b] = (char)(state >> (b % 56));
+        }
+        memcpy(&flat[flat_len], &backing[at], size);
+        flat_len += size;
+        at += size + ((state >> 20) % 3 == 0 ? 16 : 0);
+    }
+    buf_t buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.lines = lines;
+    buf.line_count = line_count;
+    buf.capacity = line_count;
+    buf.file_size = flat_len;
+
+    int failures = 0;
+    // from the start, then from byte 5 of line 3
+    size_t starts[2][2] = { { 0, 0 }, { 3, 5 } };
+    for(int s = 0; s < 2; ++s){
+        buf.cursor.current_y = starts[s][0];
+        buf.cursor.current_x = starts[s][1];
+        size_t skip = starts[s][1];
+        for(size_t i = 0; i < starts[s][0]; ++i){
+            skip += lines[i].line_size;
+        }
+
+        sha256_ctx ctx;
+        sha256_init(&ctx);
+        buf_block_iter it;
+        buffer_blocks_begin(&it, &buf);
+        const char *blocks;
+        size_t n, walked = 0;
+        while((n = buffer_blocks_next(&it, &blocks)) > 0){
+            sha256_update(&ctx, blocks, n * BUF_BLOCK_SIZE);
+            walked += n * BUF_BLOCK_SIZE;
+        }
+        const char *tail;
+        size_t tail_len = buffer_blocks_tail(&it, &tail);
+        sha256_update(&ctx, tail, tail_len);
+        walked += tail_len;
+
+        uint8_t digest[SHA256_DIGEST_SIZE], expected[SHA256_DIGEST_SIZE];
+        sha256_final(&ctx, digest);
+        sha256(&flat[skip], flat_len - skip, expected);
+        if(tail_len >= BUF_BLOCK_SIZE || walked != flat_len - skip || memcmp(digest, expected, SHA256_DIGEST_SIZE) != 0){
+            failures++;
+        }
+    }
+
+    free(flat);
+    free(backing);
+    free(lines);
+    printf("self-test: %-8s %s\n", "blocks", failures ? "FAILED" : "OK");
+    return failures == 0 ? 0 : -1;
+}
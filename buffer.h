@@ -41,13 +41,45 @@ typedef struct Buffer {
     char *filename;
     // The amount of characters on the file
     size_t file_size;
+    // 1 when lines[0].content is a read only mapping of the file, instead of heap memory
+    int mapped;
+    // loadFile(), the hole file in one allocation (with a '\0' after it), the lines point inside of it
+    char *arena;
+    // 0 while the lines of the arena weren't looked for yet
+    int indexed;
 } buf_t;
 
+// size of the chunks given by buffer_blocks_next(), the SHA-256 block
+#define BUF_BLOCK_SIZE 64
+
+// a run of bytes that are next to each other in memory
+typedef struct Buffer_span {
+    const char *ptr;
+    size_t len;
+} buf_span;
+
+// walks the buffer in whole BUF_BLOCK_SIZE chunks, from the cursor position
+typedef struct Buffer_block_iter {
+    buf_t *buf;
+    // what's left of the current run
+    buf_span span;
+    // a block that crosses from one run to another is put together here, and so is the tail
+    char staging[BUF_BLOCK_SIZE];
+    size_t staged;
+} buf_block_iter;
+
 
 // Allocating memory for the buffer
 buf_t *initBuf(const char *filename);
 // Reading file into memory
 void readFile(buf_t *buf, int option);
+// Reads the hole file into one arena, the lines are only found (with a vectorized scan for the '\n')
+// the first time something needs them, returns -1 if the file can't be read
+int loadFile(buf_t *buf);
+// Builds the line index of an arena buffer, nothing happens if it's already there, or for the other modes
+void indexLines(buf_t *buf);
+// Maps the file read only into lines[0].content, without copying it, returns -1 if it can't be mapped
+int mapFile(buf_t *buf);
 // Free the memory of the buffer
 void freeBuf(buf_t *buf);
 // Prints the buffer for debug purposes
@@ -76,6 +108,21 @@ char buffer_behind(buf_t *buf);
 void soft_reset(buf_t *buf);
 // rewinds the cursor position by an certain amount of characters
 void buffer_rewind(buf_t *buf, int amount);
+// the longest run from the cursor, lines that are next to each other in memory come together (the hole file
+// in binary or mapped mode), moves the cursor past it, returns 0 when there's nothing left
+int buffer_next_span(buf_t *buf, buf_span *span);
+// starts a block walk at the current cursor position, the walk moves the cursor
+void buffer_blocks_begin(buf_block_iter *it, buf_t *buf);
+// how many whole blocks are at *blocks, straight from the buffer when they don't cross a run,
+// 0 when less than a block is left, then buffer_blocks_tail() has the rest
+size_t buffer_blocks_next(buf_block_iter *it, const char **blocks);
+// the last bytes after the whole blocks, less than BUF_BLOCK_SIZE
+size_t buffer_blocks_tail(buf_block_iter *it, const char **tail);
+// Walks a buffer of scattered lines with buffer_blocks_next() and buffer_blocks_tail(), prints the result,
+// 0 when the blocks hash to the same digest as the flat bytes
+int buffer_blocks_self_test(void);
 buf_t *buf_string(const char *data);
+// Reads the hole stream (stdin, a pipe) into an arena buffer, like loadFile() without a file name,
+// NULL if it can't be read
 buf_t *buf_from_FILE(FILE *fp);
 #endif
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include "cache.h"
+
+/*
+ * File Description : the digest cache file
+ * a header and then a fixed amount of entries, open addressing with linear probing, when every slot
+ * of a probe is taken the oldest place (the home slot) is overwritten, it's a cache after all
+ * the file is created sparse, so the unused entries don't take disk space
+ *
+ * writers: flock() for the other processes, a mutex for the other threads of this one
+ * readers: lock free, the seq of an entry is odd while it's being written, so a reader that sees an odd
+ * seq, or a different seq after copying the entry, just treats it as a miss
+*/
+
+#define CACHE_MAGIC "SHACACH1"
+#define CACHE_VERSION 1
+// 1M entries, 80 MB of address space but only the touched pages use disk
+#define CACHE_ENTRIES (1u << 20)
+// how far a key can be from its home slot
+#define CACHE_PROBES 16
+
+typedef struct Cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t entries;
+    // keeps the entries aligned
+    uint8_t reserved[40];
+} cache_header;
+
+typedef struct Cache_entry {
+    // odd while the entry is being written
+    uint32_t seq;
+    // 1 once the entry has a key
+    uint32_t used;
+    cache_key key;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+} cache_entry;
+
+struct Digest_cache {
+    int fd;
+    void *map;
+    size_t map_size;
+    cache_entry *entries;
+    uint64_t mask;
+    pthread_mutex_t write_lock;
+};
+
+void cache_key_from_stat(const struct stat *st, cache_key *key){
+    memset(key, 0, sizeof(*key));
+    key->dev = (uint64_t)st->st_dev;
+    key->ino = (uint64_t)st->st_ino;
+    key->size = (uint64_t)st->st_size;
+    key->mtime_ns = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+    key->ctime_ns = (int64_t)st->st_ctim.tv_sec * 1000000000 + st->st_ctim.tv_nsec;
+}
+
+// splitmix64 finalizer over the key fields
+static uint64_t cache_hash(const cache_key *key){
+    uint64_t h = key->dev * 0x9e3779b97f4a7c15ULL ^ key->ino;
+    h ^= key->size + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= (uint64_t)key->mtime_ns + (h << 6) + (h >> 2);
+    h ^= (uint64_t)key->ctime_ns + (h << 6) + (h >> 2);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+static int cache_key_equal(const cache_key *a, const cache_key *b){
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+           a->mtime_ns == b->mtime_ns && a->ctime_ns == b->ctime_ns;
+}
+
+digest_cache *cache_open(const char *path){
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0){
+        fprintf(stderr, "ERROR OPENING CACHE %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    size_t map_size = sizeof(cache_header) + (size_t)CACHE_ENTRIES * sizeof(cache_entry);
+    // the first process to get here writes the header, the others wait for it
+    flock(fd, LOCK_EX);
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+    if(st.st_size == 0){
+        cache_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+        header.version = CACHE_VERSION;
+        header.entry_size = sizeof(cache_entry);
+        header.entries = CACHE_ENTRIES;
+        if(ftruncate(fd, (off_t)map_size) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)){
+            fprintf(stderr, "ERROR CREATING CACHE %s: %s\n", path, strerror(errno));
+            flock(fd, LOCK_UN);
+            close(fd);
+            return NULL;
+        }
+    }else if((size_t)st.st_size != map_size){
+        fprintf(stderr, "%s: not a cache file of this version\n", path);
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+    flock(fd, LOCK_UN);
+
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED){
+        perror("mmap failed, in function cache_open");
+        close(fd);
+        return NULL;
+    }
+    const cache_header *header = map;
+    if(memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != CACHE_VERSION ||
+       header->entry_size != sizeof(cache_entry) || header->entries != CACHE_ENTRIES){
+        fprintf(stderr, "%s: not a cache file of this version\n", path);
+        munmap(map, map_size);
+        close(fd);
+        return NULL;
+    }
+
+    digest_cache *cache = malloc(sizeof(digest_cache));
+    if(cache == NULL){
+        perror("malloc failed, in function cache_open");
+        munmap(map, map_size);
+        close(fd);
+        return NULL;
+    }
+    cache->fd = fd;
+    cache->map = map;
+    cache->map_size = map_size;
+    cache->entries = (cache_entry *)((char *)map + sizeof(cache_header));
+    cache->mask = CACHE_ENTRIES - 1;
+    pthread_mutex_init(&cache->write_lock, NULL);
+    return cache;
+}
+
+void cache_close(digest_cache *cache){
+    if(cache == NULL){
+        return;
+    }
+    pthread_mutex_destroy(&cache->write_lock);
+    munmap(cache->map, cache->map_size);
+    close(cache->fd);
+    free(cache);
+}
+
+int cache_lookup(digest_cache *cache, const cache_key *key, uint8_t digest[SHA256_DIGEST_SIZE]){
+    uint64_t home = cache_hash(key);
+    for(uint64_t probe = 0; probe < CACHE_PROBES; ++probe){
+        cache_entry *entry = &cache->entries[(home + probe) & cache->mask];
+
+        uint32_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        // someone is writing it
+        if(seq & 1){
+            continue;
+        }
+        if(!__atomic_load_n(&entry->used, __ATOMIC_RELAXED)){
+            // linear probing never leaves holes before a key, so it isn't here
+            return 0;
+        }
+        cache_entry copy;
+        memcpy(&copy, entry, sizeof(copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // changed while being copied, the copy can't be trusted
+        if(__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq){
+            continue;
+        }
+        if(cache_key_equal(&copy.key, key)){
+            memcpy(digest, copy.digest, SHA256_DIGEST_SIZE);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void cache_store(digest_cache *cache, const cache_key *key, const uint8_t digest[SHA256_DIGEST_SIZE]){
+    pthread_mutex_lock(&cache->write_lock);
+    flock(cache->fd, LOCK_EX);
+
+    uint64_t home = cache_hash(key);
+    // the same key, or the first free slot, or the home slot when the probe is full
+    cache_entry *target = &cache->entries[home & cache->mask];
+    for(uint64_t probe = 0; probe < CACHE_PROBES; ++probe){
+        cache_entry *entry = &cache->entries[(home + probe) & cache->mask];
+        if(!entry->used || cache_key_equal(&entry->key, key)){
+            target = entry;
+            break;
+        }
+    }
+
+    // an odd seq here is a writer that died holding the lock, the entry is rewritten whole anyway, so it starts
+    // from the even value below it, otherwise it would stay odd (a miss for everyone) after every store
+    uint32_t seq = target->seq & ~1u;
+    __atomic_store_n(&target->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    target->key = *key;
+    memcpy(target->digest, digest, SHA256_DIGEST_SIZE);
+    __atomic_store_n(&target->used, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&target->seq, seq + 2, __ATOMIC_RELEASE);
+
+    flock(cache->fd, LOCK_UN);
+    pthread_mutex_unlock(&cache->write_lock);
+}
@@ -0,0 +1,36 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include "sha256.h"
+
+/*
+ * File Description : persistent digest cache, a hash table on a mmap'ed file, so files that didn't change
+ * since the last run don't have to be read again
+ * a file is the same if (device, inode, size, mtime, ctime) are all the same, writers take a lock and
+ * readers don't, every entry has a sequence number that tells them if it was being written
+*/
+
+// what identifies a version of a file
+typedef struct Cache_key {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+} cache_key;
+
+typedef struct Digest_cache digest_cache;
+
+// Opens (or creates) the cache file, NULL if it can't be used
+digest_cache *cache_open(const char *path);
+// Unmaps and closes the cache
+void cache_close(digest_cache *cache);
+// Fills the key from a stat() result
+void cache_key_from_stat(const struct stat *st, cache_key *key);
+// 1 and the digest when the key is on the cache, 0 otherwise
+int cache_lookup(digest_cache *cache, const cache_key *key, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Saves the digest of the key, replacing an older entry if the table is crowded there
+void cache_store(digest_cache *cache, const cache_key *key, const uint8_t digest[SHA256_DIGEST_SIZE]);
+#endif
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cdc.h"
+#include "buffer.h"
+#include "pool.h"
+#include "stats.h"
+#include "stream.h"
+
+/*
+ * File Description : FastCDC cut points and the SHA-256 of the chunks in the same pass
+ * with one worker each chunk is hashed right after its cut is found, with more the calling thread only
+ * scans and the others hash the chunks as they're published
+*/
+
+// chunks published at once by the scan, so the hashers aren't woken for every single one
+#define CDC_PUBLISH 8
+
+// the gear table, 256 random 64 bit words (splitmix64 with a fixed seed), they only have to be the same
+// on every build so the same data always gets the same cuts
+static const uint64_t cdc_gear[256] = {
+    0xf25a39fad1d8274bULL, 0x64551a8e01446738ULL, 0x651b7408aec8f97eULL, 0x2b76c07fc4017333ULL,
+    0x1ff7856055ffeeeeULL, 0x9a66e436ad6e4c2aULL, 0x025ffc7bce5ccc5bULL, 0xb92bdcb1de703c4dULL,
+    0x2c8189f4601c77e1ULL, 0xa258634e353116c9ULL, 0x4899bf09cf1f1d45ULL, 0x1fadd0fc1ac06468ULL,
+    0xaa17d62dfb027012ULL, 0xabc2ac0731f07bffULL, 0xa1cc11f2a24a116fULL, 0x2730df12de4aa8e9ULL,
+    0x571ca27f72807159ULL, 0x74422d9d2e2e18d3ULL, 0xa5e78e8a2414469fULL, 0xfdb0ae5abeff03c0ULL,
+    0x7f6b92f7bf6a4d98ULL, 0x9a40119f473833a6ULL, 0xa5cc607f5c6e73b7ULL, 0x205651cec6948becULL,
+    0xc5b7532269d7cb4aULL, 0xfc26eada86ab3a95ULL, 0x7e948ef12fce8c61ULL, 0xa6df7fe8bad9888dULL,
+    0xa616bd25e8f0b3c0ULL, 0xdbf02c3cbbcccb89ULL, 0xfc002e603bcb0e43ULL, 0x2eb6cdf18a84d79eULL,
+    0xde03c2349a6d6110ULL, 0x038f06de91ab2bf1ULL, 0x3e4bf2c91956fd25ULL, 0xb7e6cd4467e81fcbULL,
+    0x93ca434851814f63ULL, 0xee8a56d39b74d4b2ULL, 0xd03d98b4b143a372ULL, 0x37532ec0b9445274ULL,
+    0xf7172d4ffb3c5a2bULL, 0xe2ac2914a9d23d01ULL, 0x5d5435f03a8ee17dULL, 0xd51d00e35054a7aeULL,
+    0xe7f31e736baa2bffULL, 0x40a1d53a936e5976ULL, 0x18b65673bfac7c23ULL, 0xe5095730f33a0e3cULL,
+    0x2b678bd7bdb8828cULL, 0xe88bd85557aa7d6aULL, 0x53d64a31b1cd37abULL, 0xd871c9661be5f367ULL,
+    0x797abc8d8738507cULL, 0xb1fb111dfe0b3034ULL, 0x84f349afb0c37297ULL, 0x9a2f6a20b92f31b1ULL,
+    0x31d5f3c3f6869b4fULL, 0x4d554062eba8d1c5ULL, 0xf3af10ce6ce0a04bULL, 0x16209c82aede3e94ULL,
+    0x5a8c17be00fe8e55ULL, 0x49e4f5b744a74372ULL, 0xb035202268f523a0ULL, 0x708ebb1f97210229ULL,
+    0x36ba907fa51e699aULL, 0x89908335371b9013ULL, 0x0a26d97dee78ffa0ULL, 0x95ed80c8eef3e68cULL,
+    0x3560d5c7816c1dccULL, 0x470d6339f1c1473cULL, 0x993367e1a561d4b2ULL, 0x035b08a504ccb4f6ULL,
+    0xbede2b17448f9be6ULL, 0xe2aae94a84c48316ULL, 0x341bae2c7347c775ULL, 0x238375836c81fa32ULL,
+    0x066c32e4f4d0dc93ULL, 0xc08f0375d0749a1dULL, 0x11e3eb635ed3acb3ULL, 0xbad19a27025b448aULL,
+    0xd85a802700524c7dULL, 0x5e2907158afd4806ULL, 0xeb4092892a19cc64ULL, 0x410969ca0a390ecdULL,
+    0x88a01a18a2dd0393ULL, 0x98d47acf9d49b068ULL, 0x9f3c79e09f8e94aaULL, 0xd204f94134a65397ULL,
+    0xfc6ab1939e5b104cULL, 0xa81dd0ec0ed96488ULL, 0x8d9a1f0ba9a03142ULL, 0x401abd6f769a58a0ULL,
+    0x15ddc566f0c9a804ULL, 0x5092209bc4cbed62ULL, 0x9f517950d5f864e7ULL, 0x1b199dcb6ce8fa30ULL,
+    0xcb5628419b285556ULL, 0x214df23d5e203fa9ULL, 0x08a4982c032d6e56ULL, 0x40413b5c6c119ad1ULL,
+    0x665943d75e80dc9cULL, 0xca0411299dd3d3a8ULL, 0x9d52eea3e3431bf2ULL, 0xffc2de0d6e787ddaULL,
+    0xf56f10fca9e24ef0ULL, 0xec1d94d77cc81a45ULL, 0x1188ac0f2555ea2cULL, 0x9aa447c7fd111d98ULL,
+    0x4480394361bdcdebULL, 0x513be32a27f2ec95ULL, 0xab73e7125ea6f772ULL, 0xa44b56b301027502ULL,
+    0xdc65e4b9b91af488ULL, 0x8b503adee9731921ULL, 0x820c1bcecb866914ULL, 0x6c53f90de921a4c9ULL,
+    0x0cd250ab701634c7ULL, 0xed114d3a23d938d1ULL, 0x93f97b9eb61fbef7ULL, 0x4567805cc55b58fdULL,
+    0xb821fac4e26da3c1ULL, 0x0790065c16dfa21cULL, 0x3284779a52e6cee7ULL, 0xee5e618997cee8e4ULL,
+    0xf3ffe1a315762ae4ULL, 0x268912bc6a6e6c3eULL, 0xe4c58c3ed81fef60ULL, 0xd3465b5c772f012cULL,
+    0x82f9a2112567b391ULL, 0x06978e698a70e75cULL, 0x9ec2b666cb5414f3ULL, 0x110f113c9022d956ULL,
+    0x2873f0cd3e263aa0ULL, 0x46c5f52a722b84f4ULL, 0x79f82701f4b339caULL, 0x6cb5b6d0fd68a74dULL,
+    0x09fd177733e76cd9ULL, 0x0c1c995c7fc6947aULL, 0xbc1d8b0812e8bfcdULL, 0x3dc1b6047f528cb3ULL,
+    0xd1ab243296b1d81cULL, 0x9cf889e3e5898ae3ULL, 0x9db7aa2e1fff168dULL, 0xe6c86931adcbaa9cULL,
+    0x6e222437de6f319bULL, 0x8e8048b99f362c3dULL, 0xd2ba7dc197afc09dULL, 0xaba1cd7973dff599ULL,
+    0xc2f275436a2bb0deULL, 0x7c9229f255421e0dULL, 0x4bad24b38f0efddcULL, 0x895a0ab3f6f454c0ULL,
+    0x5e2cb3550a498696ULL, 0xe2c60f7ec75f395eULL, 0xc854bc7b21d11950ULL, 0xdaeea3ae29937aeaULL,
+    0xfcf4def7cccd778fULL, 0xa7485d24b89571ffULL, 0x294d6739112deab6ULL, 0x79d701ce852b65edULL,
+    0x1ed7b681071bffe6ULL, 0x37c98dfa860281f8ULL, 0xe4b70d4bce390dc8ULL, 0xca439a990e1470c2ULL,
+    0x4ec1875967d50796ULL, 0xb6050864866db1c6ULL, 0xb7a52fd3ce9d9321ULL, 0xc81c7d97f806fd43ULL,
+    0xd6ef677e44c62997ULL, 0xde876acc0d5dac96ULL, 0x213bbfba2e4fff3aULL, 0x25dd58ec63617bd1ULL,
+    0xc7707567224713c6ULL, 0x8eae60f03831fd38ULL, 0x77a9981732d75af7ULL, 0xcf19cf4f3b562c36ULL,
+    0x3f42cb418286a507ULL, 0x4dc4283d9a7a9ae3ULL, 0xa446aa67df8e6371ULL, 0x5c88c1b1c8d8a67bULL,
+    0xd51d564d0b0fe0f6ULL, 0xea0d6de36aae6235ULL, 0x7aa095b4ddc8a854ULL, 0x0d5742152f34b614ULL,
+    0x3cc748e2be49f07cULL, 0xbecbd9f973f167c2ULL, 0x2f116bb98f093dd2ULL, 0xb1daf0eaaaf5ed3aULL,
+    0x5a8a161e8581d04aULL, 0xee420444db0f1cbdULL, 0x9bca5b3959cb40dbULL, 0xf02b0887886b203cULL,
+    0x61f4c5c4e2503225ULL, 0xa6bd5dfd50be88caULL, 0xfa94851f706b8d4fULL, 0x3f0ba638a312b00dULL,
+    0x6bb1ffd2a0aaf111ULL, 0x2f8a775f55b430b7ULL, 0x51b7c9b3c7b0806aULL, 0xdb889db474e846c1ULL,
+    0xa9b2bbe54afcd907ULL, 0xda9be6c9b0100aaeULL, 0x1c9faf4003bce0fcULL, 0x7a032539b209dfc0ULL,
+    0xb729212de3bcfb01ULL, 0xda3869b37cd1e6d0ULL, 0xe30108adfa39118eULL, 0xdbec4715d4dad625ULL,
+    0x9c84ef5a03b3c278ULL, 0xe6bf081190016b8bULL, 0xd3d975ba0e7ee44eULL, 0xc86bed0809e4c4f6ULL,
+    0x8f73d28b8e9ff938ULL, 0xb4957bf508f99f67ULL, 0xd4a55be921e3db57ULL, 0xa07192301dbc4ca6ULL,
+    0x621564c4ccd489e0ULL, 0x27fdb110066252ceULL, 0x4c875892fe3c90c5ULL, 0x5e42fb4598acd0edULL,
+    0x1d6fa2338a2176d1ULL, 0xe25666dda940a321ULL, 0x384886621468f38aULL, 0x24811cf7a55c44a7ULL,
+    0xd79e5976883bbeadULL, 0x5b52dd2b9b5b21a6ULL, 0xd01b3a6d5d03fad3ULL, 0x95c60acb738d2f35ULL,
+    0x73b53849501d7fa8ULL, 0x161d605bff0a2bd6ULL, 0xae3ede129a5fdcb4ULL, 0x892463c4f3597e88ULL,
+    0xaabb79c944e8b7f8ULL, 0x1afdc586e1d134f1ULL, 0x7ea92f99f3c8a08cULL, 0xf222686ab2dab7ccULL,
+    0x26346c6ca80e459aULL, 0x694c37c069f1fe2eULL, 0x08010e06a112ddb2ULL, 0xe3da96c3109c75abULL,
+    0x3d4d79a6186ed58cULL, 0x5aecbbd2b043a25dULL, 0xe0d4803f4a83e180ULL, 0xc9d4070501117df9ULL,
+    0xc9ede09bb7a07b21ULL, 0x020ad4d59661e17dULL, 0xfcf1fa254886e5c0ULL, 0xe4f5962c7ae44b07ULL,
+    0x4e3f327ecac281aaULL, 0x69ce1d9a2d630c1eULL, 0xd3510cda6684ad9fULL, 0x77fe623a30c1b87dULL,
+    0x1cba97e7d7b0a9aaULL, 0x096966acf02e7dccULL, 0xf571a482ae51a6b2ULL, 0x7f8b4c5cfce95838ULL,
+};
+
+// what the scan and the hashers share
+typedef struct Cdc_job {
+    const uint8_t *data;
+    size_t size;
+    const cdc_params *params;
+    cdc_chunk *chunks;
+    // chunks published by the scan, and the next one to be taken by a hasher
+    size_t found;
+    size_t next;
+    int scan_done;
+    pthread_mutex_t lock;
+    pthread_cond_t more;
+} cdc_job;
+
+void cdc_default_params(cdc_params *params){
+    params->min_size = CDC_MIN_SIZE;
+    params->avg_size = CDC_AVG_SIZE;
+    params->max_size = CDC_MAX_SIZE;
+}
+
+// bits bits spread over the top of the word, every other one from bit 63, the top bits of the gear hash
+// depend on the most bytes (bit n on the last n + 1)
+static uint64_t cdc_mask(int bits){
+    uint64_t mask = 0;
+    for(int i = 0; i < bits; ++i){
+        mask |= 1ULL << (63 - 2 * i);
+    }
+    return mask;
+}
+
+size_t cdc_next_cut(const uint8_t *data, size_t len, const cdc_params *params){
+    if(len <= params->min_size){
+        return len;
+    }
+    size_t max = len < params->max_size ? len : params->max_size;
+    size_t normal = max < params->avg_size ? max : params->avg_size;
+    // 4 times less likely to cut before the average and 4 times more after it
+    int bits = __builtin_ctzll(params->avg_size);
+    uint64_t mask_small = cdc_mask(bits + 2);
+    uint64_t mask_large = cdc_mask(bits - 2);
+
+    // nothing before min can be a cut, so the hash starts there
+    uint64_t hash = 0;
+    size_t i = params->min_size;
+    for(; i < normal; ++i){
+        hash = (hash << 1) + cdc_gear[data[i]];
+        if(!(hash & mask_small)){
+            return i + 1;
+        }
+    }
+    for(; i < max; ++i){
+        hash = (hash << 1) + cdc_gear[data[i]];
+        if(!(hash & mask_large)){
+            return i + 1;
+        }
+    }
+    return max;
+}
+
+static void cdc_hash_chunk(const cdc_job *job, cdc_chunk *chunk){
+    stats_mark mark = stats_begin();
+    sha256(&job->data[chunk->offset], chunk->length, chunk->digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(chunk->length, stats_sha256_blocks(chunk->length));
+}
+
+// the cuts from the start to the end, hashing each chunk itself when there's no one else to
+static void cdc_scan(cdc_job *job, int hash_inline){
+    size_t offset = 0;
+    size_t count = 0;
+    while(offset < job->size){
+        size_t length = cdc_next_cut(&job->data[offset], job->size - offset, job->params);
+        cdc_chunk *chunk = &job->chunks[count++];
+        chunk->offset = offset;
+        chunk->length = (uint32_t)length;
+        offset += length;
+        if(hash_inline){
+            cdc_hash_chunk(job, chunk);
+        }else if(count % CDC_PUBLISH == 0){
+            pthread_mutex_lock(&job->lock);
+            job->found = count;
+            pthread_cond_broadcast(&job->more);
+            pthread_mutex_unlock(&job->lock);
+        }
+    }
+    pthread_mutex_lock(&job->lock);
+    job->found = count;
+    job->scan_done = 1;
+    pthread_cond_broadcast(&job->more);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// task 0 is the scan, the others take the chunks it publishes until it's done and they're all taken
+static void cdc_task(size_t index, void *ctx){
+    cdc_job *job = ctx;
+    if(index == 0){
+        cdc_scan(job, 0);
+        return;
+    }
+    for(;;){
+        pthread_mutex_lock(&job->lock);
+        while(job->next >= job->found && !job->scan_done){
+            pthread_cond_wait(&job->more, &job->lock);
+        }
+        if(job->next >= job->found){
+            pthread_mutex_unlock(&job->lock);
+            return;
+        }
+        cdc_chunk *chunk = &job->chunks[job->next++];
+        pthread_mutex_unlock(&job->lock);
+        cdc_hash_chunk(job, chunk);
+    }
+}
+
+int cdc_hash_buffer(const uint8_t *data, size_t size, const cdc_params *params, int workers, cdc_chunk **chunks,
+                    size_t *count){
+    sha256_setup();
+    *chunks = NULL;
+    *count = 0;
+    if(size == 0){
+        return 0;
+    }
+
+    cdc_job job = { .data = data, .size = size, .params = params };
+    // every chunk but the last has at least min_size bytes
+    job.chunks = malloc((size / params->min_size + 1) * sizeof(cdc_chunk));
+    if(job.chunks == NULL){
+        perror("malloc failed, in function cdc_hash_buffer");
+        exit(1);
+    }
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.more, NULL);
+
+    int result = 0;
+    if(workers <= 1){
+        cdc_scan(&job, 1);
+    }else if(pool_run(workers, (size_t)workers, NULL, cdc_task, &job) != 0){
+        result = -1;
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.more);
+    if(result != 0){
+        free(job.chunks);
+        return -1;
+    }
+    *chunks = job.chunks;
+    *count = job.found;
+    return 0;
+}
+
+int cdc_hash_file(const char *path, const cdc_params *params, int workers, cdc_chunk **chunks, size_t *count){
+    stats_mark mark = stats_begin();
+    buf_t *buf = initBuf(path);
+    // what can't be mapped is read into an arena
+    const char *data;
+    if(mapFile(buf) == 0){
+        data = buf->lines[0].content;
+    }else if(loadFile(buf) == 0){
+        data = buf->arena;
+    }else{
+        fprintf(stderr, "%s: can't be read\n", path);
+        freeBuf(buf);
+        return -1;
+    }
+    stats_end(STATS_READ, mark);
+
+    int result = cdc_hash_buffer((const uint8_t *)data, buf->file_size, params, workers, chunks, count);
+    freeBuf(buf);
+    return result;
+}
+
+// a stream cut as it arrives, window[start..len) is what wasn't cut yet and starts at offset of the stream
+typedef struct Cdc_stream {
+    const cdc_params *params;
+    uint8_t *window;
+    size_t start;
+    size_t len;
+    size_t capacity;
+    uint64_t offset;
+    cdc_chunk *chunks;
+    size_t count;
+    size_t chunk_capacity;
+} cdc_stream;
+
+// a cut is only final with max_size bytes after its start (or at the end of the stream), that's as far as
+// cdc_next_cut() looks, so the chunks are the same ones a file with the same bytes gets
+static void cdc_stream_cut(cdc_stream *stream, int end){
+    while(stream->len - stream->start >= stream->params->max_size || (end && stream->start < stream->len)){
+        size_t length = cdc_next_cut(&stream->window[stream->start], stream->len - stream->start, stream->params);
+        if(stream->count >= stream->chunk_capacity){
+            stream->chunk_capacity = stream->chunk_capacity ? stream->chunk_capacity * 2 : 1024;
+            stream->chunks = realloc(stream->chunks, stream->chunk_capacity * sizeof(cdc_chunk));
+            if(stream->chunks == NULL){
+                perror("REALLOC FAILED IN FUNCTION cdc_stream_cut");
+                exit(1);
+            }
+        }
+        cdc_chunk *chunk = &stream->chunks[stream->count++];
+        chunk->offset = stream->offset;
+        chunk->length = (uint32_t)length;
+        stats_mark mark = stats_begin();
+        sha256(&stream->window[stream->start], length, chunk->digest);
+        stats_end(STATS_HASH, mark);
+        stats_message(length, stats_sha256_blocks(length));
+        stream->start += length;
+        stream->offset += length;
+    }
+}
+
+// every buffer of the ring, what's left uncut of the last one (under max_size) is moved to the front once
+static void cdc_stream_consume(const uint8_t *data, size_t len, void *ctx){
+    cdc_stream *stream = ctx;
+    memmove(stream->window, &stream->window[stream->start], stream->len - stream->start);
+    stream->len -= stream->start;
+    stream->start = 0;
+    if(stream->len + len > stream->capacity){
+        stream->capacity = stream->len + len;
+        stream->window = realloc(stream->window, stream->capacity);
+        if(stream->window == NULL){
+            perror("REALLOC FAILED IN FUNCTION cdc_stream_consume");
+            exit(1);
+        }
+    }
+    memcpy(&stream->window[stream->len], data, len);
+    stream->len += len;
+    cdc_stream_cut(stream, 0);
+}
+
+int cdc_hash_fd(int fd, const cdc_params *params, cdc_chunk **chunks, size_t *count){
+    sha256_setup();
+    cdc_stream stream = { .params = params };
+    int result = stream_fd(fd, cdc_stream_consume, &stream);
+    if(result == 0){
+        cdc_stream_cut(&stream, 1);
+    }
+    free(stream.window);
+    if(result != 0){
+        free(stream.chunks);
+        return -1;
+    }
+    *chunks = stream.chunks;
+    *count = stream.count;
+    return 0;
+}
+
+// pseudo random data, so the cuts fall like on real data
+int cdc_self_test(void){
+    const size_t size = 3 * 1024 * 1024 + 123;
+    uint8_t *data = malloc(size + 1);
+    if(data == NULL){
+        perror("malloc failed, in function cdc_self_test");
+        exit(1);
+    }
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+    for(size_t i = 0; i < size + 1; ++i){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = (uint8_t)(state >> 32);
+    }
+    cdc_params params;
+    cdc_default_params(&params);
+
+    cdc_chunk *single = NULL, *parallel = NULL, *shifted = NULL;
+    size_t single_count = 0, parallel_count = 0, shifted_count = 0;
+    int failures = 0;
+    if(cdc_hash_buffer(&data[1], size, &params, 1, &single, &single_count) != 0 ||
+       cdc_hash_buffer(&data[1], size, &params, 4, &parallel, &parallel_count) != 0 ||
+       cdc_hash_buffer(data, size + 1, &params, 1, &shifted, &shifted_count) != 0){
+        failures++;
+    }
+
+    // the chunks cover the input in order, inside the sizes, and both ways give the same ones
+    uint64_t offset = 0;
+    for(size_t i = 0; i < single_count && failures == 0; ++i){
+        uint8_t expected[SHA256_DIGEST_SIZE];
+        sha256(&data[1 + single[i].offset], single[i].length, expected);
+        int last = i == single_count - 1;
+        if(single[i].offset != offset || single[i].length > params.max_size ||
+           (!last && single[i].length < params.min_size) || memcmp(expected, single[i].digest, SHA256_DIGEST_SIZE) != 0){
+            failures++;
+        }
+        offset += single[i].length;
+    }
+    if(offset != size || single_count != parallel_count){
+        failures++;
+    }
+    for(size_t i = 0; i < single_count && failures == 0; ++i){
+        if(single[i].offset != parallel[i].offset || single[i].length != parallel[i].length ||
+           memcmp(single[i].digest, parallel[i].digest, SHA256_DIGEST_SIZE) != 0){
+            failures++;
+        }
+    }
+
+    // one byte in front only changes the first chunk, the cuts find their way back right after it
+    size_t kept = 0;
+    for(size_t i = 0; i < single_count && failures == 0; ++i){
+        for(size_t j = 0; j < shifted_count; ++j){
+            if(memcmp(single[i].digest, shifted[j].digest, SHA256_DIGEST_SIZE) == 0){
+                kept++;
+                break;
+            }
+        }
+    }
+    if(kept + 2 < single_count){
+        failures++;
+    }
+
+    printf("self-test: %-8s %s\n", "cdc", failures ? "FAILED" : "OK");
+    free(single);
+    free(parallel);
+    free(shifted);
+    free(data);
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,50 @@
+#ifndef CDC_H
+#define CDC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : content defined chunking (FastCDC), the cut points come from a rolling gear hash of the
+ * data instead of fixed offsets, so inserting or removing bytes only changes the chunks around the edit and
+ * the rest keep their digests, which is what a dedup store needs
+ * the scan and the SHA-256 of the chunks are one pass: every chunk is hashed as soon as its end is found,
+ * while it's still in the cache, on the other workers when there are more than one
+*/
+
+// the default sizes, a chunk is never shorter than min (only the last one) or longer than max
+#define CDC_MIN_SIZE (8 * 1024)
+#define CDC_AVG_SIZE (16 * 1024)
+#define CDC_MAX_SIZE (64 * 1024)
+
+typedef struct Cdc_params {
+    size_t min_size;
+    // a power of two, the cut is harder before it and easier after it (normalized chunking)
+    size_t avg_size;
+    size_t max_size;
+} cdc_params;
+
+// one chunk of the input
+typedef struct Cdc_chunk {
+    uint64_t offset;
+    uint32_t length;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+} cdc_chunk;
+
+// Fills params with the 8K/16K/64K sizes
+void cdc_default_params(cdc_params *params);
+// Where the chunk starting at data ends, len is what's left of the input
+size_t cdc_next_cut(const uint8_t *data, size_t len, const cdc_params *params);
+// Cuts and hashes size bytes, *chunks is malloc'ed (NULL for an empty input), -1 if the threads couldn't be made
+int cdc_hash_buffer(const uint8_t *data, size_t size, const cdc_params *params, int workers, cdc_chunk **chunks,
+                    size_t *count);
+// Same over a file, mapped when it can be and read into memory otherwise
+int cdc_hash_file(const char *path, const cdc_params *params, int workers, cdc_chunk **chunks, size_t *count);
+// Same over a stream (stdin, a pipe), cut and hashed on the calling thread as a reader thread brings it in,
+// only the part after the last cut is kept, -1 on read errors
+int cdc_hash_fd(int fd, const cdc_params *params, cdc_chunk **chunks, size_t *count);
+// Checks the chunks of one and many workers against each other and against sha256(), and that an insertion
+// only moves the chunks near it, prints the result, 0 when it all held
+int cdc_self_test(void);
+#endif
@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "stats.h"
+
+/*
+ * File Description : the sidecar and the hashing that keeps it up to date
+ * the sidecar is CHECKPOINT_SIZE bytes, the numbers big endian:
+ *   "SHA256CK" || version (4) || device || inode || size || mtime sec || mtime nsec || offset (8 each)
+ *   || serialized midstate (40) || SHA-256 of everything before it (32)
+ * the trailing digest catches a torn or edited sidecar, the identity catches a file that was replaced or
+ * written to since, in both cases the hashing starts over, a wrong digest is never the result of a resume
+*/
+
+#define CHECKPOINT_MAGIC "SHA256CK"
+#define CHECKPOINT_VERSION 1
+
+static void put_be64(uint8_t *out, uint64_t value){
+    for(int i = 0; i < 8; ++i){
+        out[i] = (uint8_t)(value >> (56 - i * 8));
+    }
+}
+
+static uint64_t get_be64(const uint8_t *in){
+    uint64_t value = 0;
+    for(int i = 0; i < 8; ++i){
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// path + CHECKPOINT_SUFFIX, and the same with ".tmp" for the one being written
+static char *sidecar_path(const char *path, const char *extra){
+    size_t len = strlen(path) + strlen(CHECKPOINT_SUFFIX) + strlen(extra) + 1;
+    char *sidecar = malloc(len);
+    if(sidecar == NULL){
+        perror("malloc failed, in function sidecar_path");
+        exit(1);
+    }
+    snprintf(sidecar, len, "%s%s%s", path, CHECKPOINT_SUFFIX, extra);
+    return sidecar;
+}
+
+static void identity_of(const struct stat *st, checkpoint_identity *identity){
+    identity->device = (uint64_t)st->st_dev;
+    identity->inode = (uint64_t)st->st_ino;
+    identity->size = (uint64_t)st->st_size;
+    identity->mtime_sec = (uint64_t)st->st_mtim.tv_sec;
+    identity->mtime_nsec = (uint64_t)st->st_mtim.tv_nsec;
+}
+
+static int same_identity(const checkpoint_identity *a, const checkpoint_identity *b){
+    return a->device == b->device && a->inode == b->inode && a->size == b->size &&
+           a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec;
+}
+
+// write() until everything is out, -1 on errors
+static int write_all(int fd, const uint8_t *data, size_t len){
+    while(len > 0){
+        ssize_t done = write(fd, data, len);
+        if(done < 0 && errno == EINTR){
+            continue;
+        }
+        if(done <= 0){
+            return -1;
+        }
+        data += done;
+        len -= (size_t)done;
+    }
+    return 0;
+}
+
+int checkpoint_save(const char *path, const checkpoint *ckpt){
+    uint8_t record[CHECKPOINT_SIZE];
+    uint8_t *p = record;
+    memcpy(p, CHECKPOINT_MAGIC, 8);
+    p += 8;
+    p[0] = 0; p[1] = 0; p[2] = 0; p[3] = CHECKPOINT_VERSION;
+    p += 4;
+    put_be64(p, ckpt->identity.device); p += 8;
+    put_be64(p, ckpt->identity.inode); p += 8;
+    put_be64(p, ckpt->identity.size); p += 8;
+    put_be64(p, ckpt->identity.mtime_sec); p += 8;
+    put_be64(p, ckpt->identity.mtime_nsec); p += 8;
+    put_be64(p, ckpt->offset); p += 8;
+    sha256_midstate_serialize(&ckpt->mid, p);
+    p += SHA256_MIDSTATE_SIZE;
+    sha256(record, (size_t)(p - record), p);
+
+    // the new one is complete on the disk before it takes the place of the old one
+    char *sidecar = sidecar_path(path, "");
+    char *temporary = sidecar_path(path, ".tmp");
+    int result = -1;
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd >= 0){
+        int written = write_all(fd, record, sizeof(record)) == 0 && fsync(fd) == 0;
+        written &= close(fd) == 0;
+        if(written && rename(temporary, sidecar) == 0){
+            result = 0;
+        }else{
+            unlink(temporary);
+        }
+    }
+    free(temporary);
+    free(sidecar);
+    return result;
+}
+
+int checkpoint_load(const char *path, checkpoint *ckpt){
+    char *sidecar = sidecar_path(path, "");
+    FILE *file = fopen(sidecar, "rb");
+    free(sidecar);
+    if(file == NULL){
+        return -1;
+    }
+    uint8_t record[CHECKPOINT_SIZE + 1];
+    size_t got = fread(record, 1, sizeof(record), file);
+    fclose(file);
+    if(got != CHECKPOINT_SIZE){
+        return -1;
+    }
+
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    sha256(record, CHECKPOINT_SIZE - SHA256_DIGEST_SIZE, expected);
+    if(memcmp(expected, &record[CHECKPOINT_SIZE - SHA256_DIGEST_SIZE], SHA256_DIGEST_SIZE) != 0 ||
+       memcmp(record, CHECKPOINT_MAGIC, 8) != 0 || record[8] != 0 || record[9] != 0 || record[10] != 0 ||
+       record[11] != CHECKPOINT_VERSION){
+        return -1;
+    }
+    const uint8_t *p = &record[12];
+    ckpt->identity.device = get_be64(p); p += 8;
+    ckpt->identity.inode = get_be64(p); p += 8;
+    ckpt->identity.size = get_be64(p); p += 8;
+    ckpt->identity.mtime_sec = get_be64(p); p += 8;
+    ckpt->identity.mtime_nsec = get_be64(p); p += 8;
+    ckpt->offset = get_be64(p); p += 8;
+    // the midstate has to cover exactly the bytes before the offset, and those have to be in the file
+    if(sha256_midstate_deserialize(&ckpt->mid, p) != 0 || ckpt->mid.length != ckpt->offset ||
+       ckpt->offset > ckpt->identity.size){
+        return -1;
+    }
+    return 0;
+}
+
+// fills buf until it's full or the file ends, -1 on errors
+static ssize_t checkpoint_fill(int fd, uint8_t *buf, size_t size, uint64_t offset){
+    size_t done = 0;
+    while(done < size){
+        ssize_t got = pread(fd, &buf[done], size - done, (off_t)(offset + done));
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got < 0){
+            return -1;
+        }
+        if(got == 0){
+            break;
+        }
+        done += (size_t)got;
+    }
+    return (ssize_t)done;
+}
+
+int checkpoint_hash_file(const char *path, uint64_t interval, int resume, uint8_t digest[SHA256_DIGEST_SIZE]){
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0){
+        fprintf(stderr, "ERROR OPENING FILE %s: ", path);
+        perror("");
+        if(fd >= 0){
+            close(fd);
+        }
+        return -1;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    checkpoint ckpt;
+    identity_of(&st, &ckpt.identity);
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    uint64_t offset = 0;
+    if(resume){
+        checkpoint saved;
+        if(checkpoint_load(path, &saved) == 0 && same_identity(&saved.identity, &ckpt.identity)){
+            sha256_import_midstate(&ctx, &saved.mid);
+            offset = saved.offset;
+            fprintf(stderr, "%s: resuming at byte %llu\n", path, (unsigned long long)offset);
+        }else{
+            // only worth a word when there was a sidecar and it couldn't be used
+            char *sidecar = sidecar_path(path, "");
+            if(access(sidecar, F_OK) == 0){
+                fprintf(stderr, "%s: the checkpoint doesn't match the file, starting over\n", path);
+            }
+            free(sidecar);
+        }
+    }
+
+    uint8_t *chunk = malloc(CHECKPOINT_READ_SIZE);
+    if(chunk == NULL){
+        perror("malloc failed, in function checkpoint_hash_file");
+        exit(1);
+    }
+    uint64_t next_save = offset + interval;
+    // a sidecar that can't be written is said once, the hashing goes on without it
+    int saving = 1;
+    int failed = 0;
+    for(;;){
+        stats_mark mark = stats_begin();
+        ssize_t got = checkpoint_fill(fd, chunk, CHECKPOINT_READ_SIZE, offset);
+        stats_end(STATS_READ, mark);
+        if(got < 0){
+            fprintf(stderr, "read failed at checkpoint_hash_file func, on %s\n", path);
+            failed = 1;
+            break;
+        }
+        if(got == 0){
+            break;
+        }
+        mark = stats_begin();
+        sha256_update(&ctx, chunk, (size_t)got);
+        stats_end(STATS_HASH, mark);
+        offset += (size_t)got;
+
+        // the reads are whole blocks until the last one, so the midstate covers everything up to offset
+        if(saving && offset >= next_save && sha256_export_midstate(&ctx, &ckpt.mid) == 0){
+            ckpt.offset = offset;
+            if(checkpoint_save(path, &ckpt) != 0){
+                fprintf(stderr, "%s: can't write the checkpoint, going on without it\n", path);
+                saving = 0;
+            }
+            next_save = offset + interval;
+        }
+    }
+    free(chunk);
+    close(fd);
+    if(failed){
+        // the last checkpoint stays, a --resume carries on from it
+        return -1;
+    }
+
+    stats_mark mark = stats_begin();
+    sha256_final(&ctx, digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(ctx.total_len, stats_sha256_blocks(ctx.total_len));
+    char *sidecar = sidecar_path(path, "");
+    unlink(sidecar);
+    free(sidecar);
+    return 0;
+}
+
+// a file written to /tmp, hashed with a checkpoint saved half way, then with a damaged and a stale one
+int checkpoint_self_test(void){
+    char path[] = "/tmp/sha-checkpoint-XXXXXX";
+    int fd = mkstemp(path);
+    const size_t size = 3 * CHECKPOINT_READ_SIZE + 123;
+    uint8_t *data = malloc(size);
+    if(data == NULL){
+        perror("malloc failed, in function checkpoint_self_test");
+        exit(1);
+    }
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for(size_t i = 0; i < size; ++i){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = (uint8_t)(state >> 32);
+    }
+    int failures = 0;
+    struct stat st;
+    if(fd < 0 || write_all(fd, data, size) != 0 || fstat(fd, &st) != 0){
+        printf("self-test: %-8s %s\n", "checkpoint", "FAILED");
+        if(fd >= 0){
+            close(fd);
+            unlink(path);
+        }
+        free(data);
+        return -1;
+    }
+    close(fd);
+
+    uint8_t expected[SHA256_DIGEST_SIZE], digest[SHA256_DIGEST_SIZE];
+    sha256(data, size, expected);
+    char *sidecar = sidecar_path(path, "");
+
+    // a full run saves along the way and leaves nothing behind
+    if(checkpoint_hash_file(path, CHECKPOINT_READ_SIZE, 0, digest) != 0 || memcmp(expected, digest, SHA256_DIGEST_SIZE) != 0 ||
+       access(sidecar, F_OK) == 0){
+        failures++;
+    }
+
+    // the resumes talk on stderr, that would only make the report look like it failed
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    if(null >= 0){
+        dup2(null, STDERR_FILENO);
+        close(null);
+    }
+
+    // a checkpoint with the midstate of other bytes, the digest is only wrong if the resume really used it
+    checkpoint ckpt;
+    identity_of(&st, &ckpt.identity);
+    ckpt.offset = CHECKPOINT_READ_SIZE;
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, &data[1], CHECKPOINT_READ_SIZE);
+    sha256_export_midstate(&ctx, &ckpt.mid);
+    checkpoint loaded;
+    if(checkpoint_save(path, &ckpt) != 0 || checkpoint_load(path, &loaded) != 0 || loaded.offset != ckpt.offset ||
+       !same_identity(&loaded.identity, &ckpt.identity) ||
+       checkpoint_hash_file(path, CHECKPOINT_READ_SIZE, 1, digest) != 0 || memcmp(expected, digest, SHA256_DIGEST_SIZE) == 0){
+        failures++;
+    }
+
+    // the right midstate gives the right digest
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, CHECKPOINT_READ_SIZE);
+    sha256_export_midstate(&ctx, &ckpt.mid);
+    if(checkpoint_save(path, &ckpt) != 0 || checkpoint_hash_file(path, CHECKPOINT_READ_SIZE, 1, digest) != 0 ||
+       memcmp(expected, digest, SHA256_DIGEST_SIZE) != 0){
+        failures++;
+    }
+
+    // a byte flipped in the sidecar, or a file that's not the same anymore, and it starts over
+    checkpoint_save(path, &ckpt);
+    FILE *file = fopen(sidecar, "r+b");
+    if(file == NULL || fseek(file, 20, SEEK_SET) != 0 || fputc(0xFF, file) == EOF){
+        failures++;
+    }
+    if(file != NULL){
+        fclose(file);
+    }
+    if(checkpoint_load(path, &loaded) == 0){
+        failures++;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, &data[1], CHECKPOINT_READ_SIZE);
+    sha256_export_midstate(&ctx, &ckpt.mid);
+    ckpt.identity.mtime_nsec ^= 1;
+    if(checkpoint_save(path, &ckpt) != 0 || checkpoint_hash_file(path, CHECKPOINT_READ_SIZE, 1, digest) != 0 ||
+       memcmp(expected, digest, SHA256_DIGEST_SIZE) != 0){
+        failures++;
+    }
+    if(saved_stderr >= 0){
+        dup2(saved_stderr, STDERR_FILENO);
+        close(saved_stderr);
+    }
+
+    unlink(sidecar);
+    unlink(path);
+    free(sidecar);
+    free(data);
+    printf("self-test: %-8s %s\n", "checkpoint", failures ? "FAILED" : "OK");
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,48 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : --checkpoint and --resume, for files so big that starting over is hours
+ * every interval bytes the midstate, the offset and the identity of the file (device, inode, size, mtime)
+ * go to a sidecar next to it, <file>.sha256-checkpoint, and --resume carries on from there instead of from
+ * byte 0. The sidecar ends with its own SHA-256 and is replaced with a rename, so a crash while it's being
+ * written leaves the previous one, and it's only used if the file is still the same one
+*/
+
+#define CHECKPOINT_DEFAULT_INTERVAL (1024ULL * 1024 * 1024)
+#define CHECKPOINT_SUFFIX ".sha256-checkpoint"
+// magic, version, identity (5 x 8), offset, midstate, SHA-256 of all of it
+#define CHECKPOINT_SIZE (8 + 4 + 5 * 8 + 8 + SHA256_MIDSTATE_SIZE + SHA256_DIGEST_SIZE)
+// each read, a multiple of the block so every checkpoint falls on a block boundary
+#define CHECKPOINT_READ_SIZE (1024 * 1024)
+
+// what makes a file the same file
+typedef struct Checkpoint_identity {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtime_sec;
+    uint64_t mtime_nsec;
+} checkpoint_identity;
+
+typedef struct Checkpoint {
+    checkpoint_identity identity;
+    // bytes already in the midstate, a multiple of 64
+    uint64_t offset;
+    sha256_midstate mid;
+} checkpoint;
+
+// Hashes the file, saving a checkpoint every interval bytes, and starting from the saved one when resume is
+// set and it's still valid, the sidecar is removed once the digest is done, -1 if the file can't be read
+int checkpoint_hash_file(const char *path, uint64_t interval, int resume, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Writes the sidecar of path, atomically, -1 if it can't be written
+int checkpoint_save(const char *path, const checkpoint *ckpt);
+// Reads the sidecar of path, -1 when there's none or it's damaged
+int checkpoint_load(const char *path, checkpoint *ckpt);
+// Interrupts a hash half way with a saved checkpoint and resumes it, prints the result, 0 when the digest matched
+int checkpoint_self_test(void);
+#endif
@@ -0,0 +1,725 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "daemon.h"
+#include "batch.h"
+#include "buffer.h"
+#include "stats.h"
+
+/*
+ * File Description : the daemon is one thread with poll() over the listening socket and every connection,
+ * each turn it reads what arrived, cuts it into requests, hashes all of them in one sha256_batch_workers()
+ * call (inline data straight from the read buffers, files read whole with pread) and queues the answers in order
+ * files aren't mapped, a client that truncates one before the batch would kill the daemon with a SIGBUS
+ * 'P' opens the path with the rights of the daemon, so the socket is 0600 and a connection from another
+ * user (root aside) is closed right away, nobody gets the digest of a file they couldn't read themselves
+*/
+
+// read from a connection at a time
+#define DAEMON_READ_SIZE (64 * 1024)
+// descriptors taken per recvmsg, and the most that can wait on a connection for their 'F' header
+#define DAEMON_MAX_FDS 16
+#define DAEMON_FD_QUEUE 256
+// a connection with this much unsent stops being read until the client takes it
+#define DAEMON_OUT_HIGH (4 * 1024 * 1024)
+
+typedef struct Daemon_conn {
+    int fd;
+    // what was read, requests are cut from the front up to in_parsed
+    uint8_t *in;
+    size_t in_len;
+    size_t in_cap;
+    size_t in_parsed;
+    // the answers not sent yet
+    uint8_t *out;
+    size_t out_len;
+    size_t out_cap;
+    size_t out_sent;
+    // descriptors that came with SCM_RIGHTS, taken in order by the 'F' requests
+    int fds[DAEMON_FD_QUEUE];
+    size_t fd_head;
+    size_t fd_count;
+    // the client finished sending (it still gets its answers), or the connection broke
+    int eof;
+    int broken;
+} daemon_conn;
+
+// one request of the batch
+typedef struct Daemon_request {
+    daemon_conn *conn;
+    const uint8_t *data;
+    size_t len;
+    // the copy of a file, freed after the batch
+    uint8_t *copy;
+    // a file over DAEMON_MAX_DATA is hashed on its own as it's read, not in the batch
+    int hashed;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    uint8_t status;
+} daemon_request;
+
+typedef struct Daemon_batch {
+    daemon_request *requests;
+    size_t count;
+    size_t capacity;
+} daemon_batch;
+
+static volatile sig_atomic_t daemon_stop;
+// what an empty file points to, the batch never gets a NULL message
+static const uint8_t daemon_empty[1];
+
+static void daemon_signal(int sig){
+    (void)sig;
+    daemon_stop = 1;
+}
+
+static uint32_t load_be32(const uint8_t *p){
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void store_be32(uint8_t *p, uint32_t v){
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// grows *buf so it has room for need more bytes after len
+static void reserve(uint8_t **buf, size_t *cap, size_t len, size_t need){
+    if(*cap - len >= need){
+        return;
+    }
+    size_t grown = *cap ? *cap : DAEMON_READ_SIZE;
+    while(grown - len < need){
+        grown *= 2;
+    }
+    uint8_t *bigger = realloc(*buf, grown);
+    if(bigger == NULL){
+        perror("REALLOC FAILED IN FUNCTION reserve");
+        exit(1);
+    }
+    *buf = bigger;
+    *cap = grown;
+}
+
+static void set_nonblocking(int fd){
+    int flags = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void conn_close(daemon_conn *conn){
+    for(size_t i = 0; i < conn->fd_count; ++i){
+        close(conn->fds[(conn->fd_head + i) % DAEMON_FD_QUEUE]);
+    }
+    close(conn->fd);
+    free(conn->in);
+    free(conn->out);
+    free(conn);
+}
+
+// whatever is waiting on the socket, with the descriptors that came along
+static void conn_read(daemon_conn *conn){
+    reserve(&conn->in, &conn->in_cap, conn->in_len, DAEMON_READ_SIZE);
+    struct iovec iov = { &conn->in[conn->in_len], conn->in_cap - conn->in_len };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * DAEMON_MAX_FDS)];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+    ssize_t got = recvmsg(conn->fd, &msg, flags);
+    if(got < 0){
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+            conn->broken = 1;
+        }
+        return;
+    }
+    if(got == 0){
+        conn->eof = 1;
+        return;
+    }
+    conn->in_len += (size_t)got;
+
+    for(struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c)){
+        if(c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS){
+            continue;
+        }
+        size_t n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int fds[DAEMON_MAX_FDS];
+        memcpy(fds, CMSG_DATA(c), n * sizeof(int));
+        for(size_t i = 0; i < n; ++i){
+            // a client that sends descriptors without their requests only loses them
+            if(conn->fd_count == DAEMON_FD_QUEUE){
+                close(fds[i]);
+                continue;
+            }
+            conn->fds[(conn->fd_head + conn->fd_count++) % DAEMON_FD_QUEUE] = fds[i];
+        }
+    }
+}
+
+static void conn_write(daemon_conn *conn){
+    while(conn->out_sent < conn->out_len){
+        ssize_t n = send(conn->fd, &conn->out[conn->out_sent], conn->out_len - conn->out_sent, 0);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                conn->broken = 1;
+            }
+            return;
+        }
+        conn->out_sent += (size_t)n;
+    }
+    conn->out_sent = 0;
+    conn->out_len = 0;
+}
+
+// a file too big to be copied whole, hashed DAEMON_READ_SIZE at a time, -1 on a read error
+static int request_hash_fd(daemon_request *request, int fd){
+    uint8_t chunk[DAEMON_READ_SIZE];
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    off_t offset = 0;
+    for(;;){
+        ssize_t got = pread(fd, chunk, sizeof(chunk), offset);
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got < 0){
+            return -1;
+        }
+        if(got == 0){
+            break;
+        }
+        sha256_update(&ctx, chunk, (size_t)got);
+        offset += got;
+    }
+    sha256_final(&ctx, request->digest);
+    stats_message((uint64_t)offset, stats_sha256_blocks((uint64_t)offset));
+    request->hashed = 1;
+    return 0;
+}
+
+// the request hashes the file behind fd, copied with pread (a file that shrinks meanwhile is hashed as far
+// as it goes, it can't fault like a mapping would), fd is closed
+static void request_read(daemon_request *request, int fd){
+    struct stat st;
+    request->data = daemon_empty;
+    request->len = 0;
+    if(fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        request->status = DAEMON_UNREADABLE;
+    }else if(st.st_size > DAEMON_MAX_DATA){
+        if(request_hash_fd(request, fd) != 0){
+            request->status = DAEMON_UNREADABLE;
+        }
+    }else if(st.st_size > 0){
+        uint8_t *copy = malloc((size_t)st.st_size);
+        if(copy == NULL){
+            perror("malloc failed, in function request_read");
+            exit(1);
+        }
+        size_t len = 0;
+        ssize_t got = 0;
+        while(len < (size_t)st.st_size){
+            got = pread(fd, &copy[len], (size_t)st.st_size - len, (off_t)len);
+            if(got < 0 && errno == EINTR){
+                continue;
+            }
+            if(got <= 0){
+                break;
+            }
+            len += (size_t)got;
+        }
+        if(got < 0){
+            free(copy);
+            request->status = DAEMON_UNREADABLE;
+        }else{
+            request->copy = copy;
+            request->data = copy;
+            request->len = len;
+        }
+    }
+    if(fd >= 0){
+        close(fd);
+    }
+}
+
+// cuts the whole requests that arrived on conn into the batch, -1 if the connection sent something wrong
+static int conn_parse(daemon_conn *conn, daemon_batch *batch){
+    while(conn->in_len - conn->in_parsed >= DAEMON_HEADER_SIZE){
+        const uint8_t *header = &conn->in[conn->in_parsed];
+        uint32_t len = load_be32(&header[1]);
+        if(len > DAEMON_MAX_DATA){
+            return -1;
+        }
+        if(conn->in_len - conn->in_parsed - DAEMON_HEADER_SIZE < len){
+            break;
+        }
+
+        if(batch->count >= batch->capacity){
+            batch->capacity = batch->capacity ? batch->capacity * 2 : 64;
+            batch->requests = realloc(batch->requests, batch->capacity * sizeof(daemon_request));
+            if(batch->requests == NULL){
+                perror("REALLOC FAILED IN FUNCTION conn_parse");
+                exit(1);
+            }
+        }
+        daemon_request *request = &batch->requests[batch->count++];
+        memset(request, 0, sizeof(*request));
+        request->conn = conn;
+        request->data = &header[DAEMON_HEADER_SIZE];
+        request->len = len;
+        request->status = DAEMON_OK;
+
+        if(header[0] == DAEMON_PATH){
+            char path[PATH_MAX];
+            if(len == 0 || len >= sizeof(path)){
+                request->status = DAEMON_UNREADABLE;
+            }else{
+                memcpy(path, &header[DAEMON_HEADER_SIZE], len);
+                path[len] = '\0';
+                request_read(request, open(path, O_RDONLY | O_CLOEXEC));
+            }
+        }else if(header[0] == DAEMON_FD){
+            if(conn->fd_count == 0){
+                request->status = DAEMON_BAD_REQUEST;
+            }else{
+                int fd = conn->fds[conn->fd_head];
+                conn->fd_head = (conn->fd_head + 1) % DAEMON_FD_QUEUE;
+                conn->fd_count--;
+                request_read(request, fd);
+            }
+        }else if(header[0] != DAEMON_DATA){
+            request->status = DAEMON_BAD_REQUEST;
+        }
+        conn->in_parsed += DAEMON_HEADER_SIZE + len;
+    }
+    return 0;
+}
+
+// every request of the turn in one call, then the answers go to their connections in order
+static void batch_answer(daemon_batch *batch, int workers){
+    const uint8_t **msgs = malloc(batch->count * sizeof(uint8_t *));
+    size_t *lens = malloc(batch->count * sizeof(size_t));
+    uint8_t (*digests)[SHA256_DIGEST_SIZE] = malloc(batch->count * SHA256_DIGEST_SIZE);
+    size_t *which = malloc(batch->count * sizeof(size_t));
+    if(msgs == NULL || lens == NULL || digests == NULL || which == NULL){
+        perror("malloc failed, in function batch_answer");
+        exit(1);
+    }
+    size_t n = 0;
+    uint64_t bytes = 0;
+    for(size_t i = 0; i < batch->count; ++i){
+        if(batch->requests[i].status == DAEMON_OK && !batch->requests[i].hashed){
+            msgs[n] = batch->requests[i].data;
+            lens[n] = batch->requests[i].len;
+            bytes += lens[n];
+            which[n++] = i;
+        }
+    }
+
+    stats_mark mark = stats_begin();
+    // without memory for the pool the calling thread can still hash it all
+    if(sha256_batch_workers(msgs, lens, n, digests, workers) != 0 &&
+       sha256_batch_workers(msgs, lens, n, digests, 1) != 0){
+        exit(1);
+    }
+    stats_end(STATS_HASH, mark);
+    for(size_t i = 0; i < n; ++i){
+        stats_message(lens[i], stats_sha256_blocks(lens[i]));
+    }
+
+    size_t next = 0;
+    for(size_t i = 0; i < batch->count; ++i){
+        daemon_request *request = &batch->requests[i];
+        daemon_conn *conn = request->conn;
+        reserve(&conn->out, &conn->out_cap, conn->out_len, DAEMON_ANSWER_SIZE);
+        uint8_t *answer = &conn->out[conn->out_len];
+        answer[0] = request->status;
+        if(next < n && which[next] == i){
+            memcpy(&answer[1], digests[next++], SHA256_DIGEST_SIZE);
+        }else if(request->status == DAEMON_OK && request->hashed){
+            memcpy(&answer[1], request->digest, SHA256_DIGEST_SIZE);
+        }else{
+            memset(&answer[1], 0, SHA256_DIGEST_SIZE);
+        }
+        conn->out_len += DAEMON_ANSWER_SIZE;
+        free(request->copy);
+    }
+    batch->count = 0;
+    free(msgs);
+    free(lens);
+    free(digests);
+    free(which);
+}
+
+// the user the daemon runs as, or root, anyone else could have it open paths they can't read
+static int daemon_peer_allowed(int fd){
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0){
+        return 0;
+    }
+    return cred.uid == geteuid() || cred.uid == 0;
+#else
+    (void)fd;
+    return 1;
+#endif
+}
+
+// a socket file that nobody answers on is left over from a daemon that's gone, it's replaced
+static int daemon_listen(const char *path){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "%s: the socket path is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0){
+        perror("socket failed, in function daemon_listen");
+        return -1;
+    }
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0){
+        fprintf(stderr, "%s: a daemon is already running there\n", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+    // created 0600 straight away, a chmod after the bind would leave a moment where anyone can connect
+    mode_t saved_umask = umask(0177);
+    int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(saved_umask);
+    if(bound != 0 || listen(fd, SOMAXCONN) != 0){
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    set_nonblocking(fd);
+    return fd;
+}
+
+int daemon_serve(const char *path, int workers){
+    int listener = daemon_listen(path);
+    if(listener < 0){
+        return -1;
+    }
+    // no SA_RESTART, so the signal gets poll() out
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = daemon_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    // a client that left before its answers is only a broken connection
+    signal(SIGPIPE, SIG_IGN);
+    sha256_setup();
+    fprintf(stderr, "listening on %s\n", path);
+
+    daemon_conn **conns = NULL;
+    struct pollfd *polls = NULL;
+    size_t conn_count = 0, conn_cap = 0;
+    daemon_batch batch = { NULL, 0, 0 };
+
+    while(!daemon_stop){
+        polls = realloc(polls, (conn_count + 1) * sizeof(struct pollfd));
+        if(polls == NULL){
+            perror("REALLOC FAILED IN FUNCTION daemon_serve");
+            exit(1);
+        }
+        polls[0].fd = listener;
+        polls[0].events = POLLIN;
+        for(size_t i = 0; i < conn_count; ++i){
+            daemon_conn *conn = conns[i];
+            size_t backlog = conn->out_len - conn->out_sent;
+            polls[i + 1].fd = conn->fd;
+            polls[i + 1].events = (backlog > 0 ? POLLOUT : 0) | (!conn->eof && backlog < DAEMON_OUT_HIGH ? POLLIN : 0);
+            polls[i + 1].revents = 0;
+        }
+        if(poll(polls, conn_count + 1, -1) < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("poll failed, in function daemon_serve");
+            break;
+        }
+
+        // the new connections are read from the next turn on
+        size_t polled = conn_count;
+        if(polls[0].revents & POLLIN){
+            int fd;
+            while((fd = accept(listener, NULL, NULL)) >= 0){
+                if(!daemon_peer_allowed(fd)){
+                    close(fd);
+                    continue;
+                }
+                set_nonblocking(fd);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                daemon_conn *conn = calloc(1, sizeof(daemon_conn));
+                if(conn == NULL){
+                    perror("calloc failed, in function daemon_serve");
+                    exit(1);
+                }
+                conn->fd = fd;
+                if(conn_count >= conn_cap){
+                    conn_cap = conn_cap ? conn_cap * 2 : 16;
+                    conns = realloc(conns, conn_cap * sizeof(daemon_conn *));
+                    if(conns == NULL){
+                        perror("REALLOC FAILED IN FUNCTION daemon_serve");
+                        exit(1);
+                    }
+                }
+                conns[conn_count++] = conn;
+            }
+        }
+
+        // everything is read before anything is cut, the requests point into the read buffers
+        for(size_t i = 0; i < polled; ++i){
+            short revents = polls[i + 1].revents;
+            if(revents & POLLERR){
+                conns[i]->broken = 1;
+            }else if(revents & (POLLIN | POLLHUP)){
+                conn_read(conns[i]);
+            }
+        }
+        for(size_t i = 0; i < conn_count; ++i){
+            if(!conns[i]->broken && conn_parse(conns[i], &batch) != 0){
+                conns[i]->broken = 1;
+            }
+        }
+        if(batch.count > 0){
+            batch_answer(&batch, workers);
+        }
+
+        // the bytes of the requests that were answered are dropped, a request that isn't complete moves to the front
+        for(size_t i = 0; i < conn_count; ++i){
+            daemon_conn *conn = conns[i];
+            memmove(conn->in, &conn->in[conn->in_parsed], conn->in_len - conn->in_parsed);
+            conn->in_len -= conn->in_parsed;
+            conn->in_parsed = 0;
+            if(!conn->broken && conn->out_len > conn->out_sent){
+                conn_write(conn);
+            }
+        }
+        // a client that finished sending is closed once it has all of its answers
+        size_t kept = 0;
+        for(size_t i = 0; i < conn_count; ++i){
+            daemon_conn *conn = conns[i];
+            if(conn->broken || (conn->eof && conn->out_len == conn->out_sent)){
+                conn_close(conn);
+            }else{
+                conns[kept++] = conn;
+            }
+        }
+        conn_count = kept;
+    }
+
+    for(size_t i = 0; i < conn_count; ++i){
+        conn_close(conns[i]);
+    }
+    free(conns);
+    free(polls);
+    free(batch.requests);
+    close(listener);
+    unlink(path);
+    return 0;
+}
+
+static int write_all(int fd, const void *data, size_t len){
+    const uint8_t *p = data;
+    while(len > 0){
+        ssize_t n = send(fd, p, len, 0);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *data, size_t len){
+    uint8_t *p = data;
+    while(len > 0){
+        ssize_t n = recv(fd, p, len, 0);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// the header alone, with fd riding along when it isn't -1
+static int send_header(int sock, uint8_t op, uint32_t len, int fd){
+    uint8_t header[DAEMON_HEADER_SIZE];
+    header[0] = op;
+    store_be32(&header[1], len);
+    if(fd < 0){
+        return write_all(sock, header, sizeof(header));
+    }
+
+    struct iovec iov = { header, sizeof(header) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(c), &fd, sizeof(int));
+
+    // the descriptor goes with the first byte, the rest of the header can follow on its own
+    ssize_t n;
+    while((n = sendmsg(sock, &msg, 0)) < 0 && errno == EINTR){
+    }
+    if(n <= 0){
+        return -1;
+    }
+    return write_all(sock, &header[n], sizeof(header) - (size_t)n);
+}
+
+// one argument as a request, 1 when it was sent, 0 when it can't be (the error is printed), -1 if the socket broke
+static int client_send(int sock, const char *arg, int send_fds){
+    struct stat st;
+    if(strcmp(arg, "-") == 0){
+        buf_t *buf = buf_from_FILE(stdin);
+        if(buf == NULL){
+            return 0;
+        }
+        int result = -1;
+        if(buf->file_size > DAEMON_MAX_DATA){
+            fprintf(stderr, "-: more than %d bytes, send it as a file\n", DAEMON_MAX_DATA);
+            result = 0;
+        }else if(send_header(sock, DAEMON_DATA, (uint32_t)buf->file_size, -1) == 0 &&
+                 write_all(sock, buf->arena, buf->file_size) == 0){
+            result = 1;
+        }
+        freeBuf(buf);
+        return result;
+    }
+    if(stat(arg, &st) == 0 && S_ISDIR(st.st_mode)){
+        fprintf(stderr, "%s: Is a directory\n", arg);
+        return 0;
+    }
+    if(stat(arg, &st) == 0 && S_ISREG(st.st_mode)){
+        if(send_fds){
+            int fd = open(arg, O_RDONLY);
+            if(fd < 0){
+                fprintf(stderr, "ERROR OPENING FILE %s: %s\n", arg, strerror(errno));
+                return 0;
+            }
+            int result = send_header(sock, DAEMON_FD, 0, fd) == 0 ? 1 : -1;
+            close(fd);
+            return result;
+        }
+        char path[PATH_MAX];
+        if(realpath(arg, path) == NULL){
+            fprintf(stderr, "%s: %s\n", arg, strerror(errno));
+            return 0;
+        }
+        size_t len = strlen(path);
+        return send_header(sock, DAEMON_PATH, (uint32_t)len, -1) == 0 && write_all(sock, path, len) == 0 ? 1 : -1;
+    }
+    size_t len = strlen(arg);
+    return send_header(sock, DAEMON_DATA, (uint32_t)len, -1) == 0 && write_all(sock, arg, len) == 0 ? 1 : -1;
+}
+
+int daemon_client(const char *path, const char *const *args, size_t count, int send_fds){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "%s: the socket path is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+        fprintf(stderr, "%s: no daemon: %s\n", path, strerror(errno));
+        if(sock >= 0){
+            close(sock);
+        }
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // a window of requests goes out before its answers are read, so the daemon can batch them
+    int failed = 0;
+    int sent[DAEMON_CLIENT_WINDOW];
+    for(size_t start = 0; start < count && failed >= 0; start += DAEMON_CLIENT_WINDOW){
+        size_t end = count - start < DAEMON_CLIENT_WINDOW ? count : start + DAEMON_CLIENT_WINDOW;
+        for(size_t i = start; i < end; ++i){
+            sent[i - start] = client_send(sock, args[i], send_fds);
+            if(sent[i - start] < 0){
+                end = i;
+                failed = -1;
+                break;
+            }
+        }
+        for(size_t i = start; i < end; ++i){
+            if(!sent[i - start]){
+                failed = failed < 0 ? failed : 1;
+                continue;
+            }
+            uint8_t answer[DAEMON_ANSWER_SIZE];
+            if(read_all(sock, answer, sizeof(answer)) != 0){
+                failed = -1;
+                break;
+            }
+            if(answer[0] != DAEMON_OK){
+                fprintf(stderr, "%s: %s\n", args[i], answer[0] == DAEMON_UNREADABLE ? "the daemon couldn't read it"
+                                                                                    : "bad request");
+                failed = failed < 0 ? failed : 1;
+                continue;
+            }
+            char hex[2 * SHA256_DIGEST_SIZE + 1];
+            sha256_hex(&answer[1], hex);
+            printf("%s  %s\n", hex, args[i]);
+        }
+    }
+    if(failed < 0){
+        fprintf(stderr, "%s: the connection to the daemon broke\n", path);
+    }
+    close(sock);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,48 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : --daemon, a hasher that stays up on a unix socket, so the callers that hash small
+ * inputs many times a second don't pay the exec, the dynamic linking and the setup every time
+ *
+ * a connection sends any amount of requests without waiting for the answers, and gets one answer per
+ * request in the same order, the numbers are big endian:
+ *   request  = op (1 byte) || length (4 bytes) || length bytes
+ *     'D'  the bytes are the message
+ *     'P'  the bytes are the path of a file (absolute, the daemon has its own working directory)
+ *     'F'  length is 0, the file is the descriptor sent with SCM_RIGHTS along with this header
+ *   answer   = status (1 byte) || SHA-256 (32 bytes, zeros when the status isn't DAEMON_OK)
+ * the requests of every connection that are in by the time the daemon looks are hashed as one batch,
+ * files (read whole, up to DAEMON_MAX_DATA) together with inline data, so concurrent small requests share the
+ * multi buffer kernels, a bigger file is hashed on its own as it's read
+ * the socket is created 0600 and only the user running the daemon (and root) can talk to it
+*/
+
+#define DAEMON_DATA 'D'
+#define DAEMON_PATH 'P'
+#define DAEMON_FD 'F'
+
+#define DAEMON_OK 0
+// the file couldn't be opened or read
+#define DAEMON_UNREADABLE 1
+// an unknown op, or an 'F' without a descriptor
+#define DAEMON_BAD_REQUEST 2
+
+#define DAEMON_HEADER_SIZE 5
+#define DAEMON_ANSWER_SIZE (1 + SHA256_DIGEST_SIZE)
+// a longer inline message closes the connection, big inputs should go as files, a file up to this size
+// is copied into the batch
+#define DAEMON_MAX_DATA (64 * 1024 * 1024)
+// requests the client sends before it reads their answers
+#define DAEMON_CLIENT_WINDOW 64
+
+// Serves on the socket at path until SIGINT or SIGTERM, batches over 1M use up to workers threads
+int daemon_serve(const char *path, int workers);
+// The test client, sends every argument like the normal mode takes them (files by path, or as descriptors
+// when send_fds is set, "-" as stdin, anything else as a string) and prints "<hex>  <argument>"
+int daemon_client(const char *path, const char *const *args, size_t count, int send_fds);
+#endif
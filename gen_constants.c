@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "gen_constants.h"
+
+/*
+ * File Description : build time generator of the SHA-256 constants
+ * the Makefile runs it and saves the output as sha256_constants.h, so the hasher starts with the
+ * tables ready instead of running the sieve and the cubic roots on every invocation
+*/
+
+// returns an array of all the first 64 prime numbers 
+uint32_t *prime_arr_generator(void){
+    int limit = 311;
+    int is_prime[limit + 1];
+
+    for(int i = 0; i <= limit; i++){
+        is_prime[i] = 1;
+    }
+    
+    is_prime[0] = is_prime[1] = 0;
+
+    for(int i = 2; i * i <= limit; i++){
+        if(is_prime[i]){
+            for(int j = i * i; j <= limit; j += i){
+                is_prime[j] = 0;
+            }
+        }
+    }
+
+    uint32_t *primes = malloc(sizeof(uint32_t) * NUM_OF_PRIMES);
+    if(primes == NULL){
+        perror("malloc failed, in function prime_arr_generator");
+        exit(1);
+        return NULL;
+    }
+
+    int count = 0;
+    for(int i = 2; i <= limit && count < NUM_OF_PRIMES; i++){
+        if(is_prime[i]){
+            primes[count++] = i;
+        }
+    }
+
+    return primes;
+}
+
+// Initialize array of round constants
+uint32_t *initialize_array_of_constants(uint32_t *primes){
+    if(primes == NULL){
+        perror("the argument was NULL, in function initialize_array_of_conastants");
+        exit(1);
+        return NULL;
+    }
+
+    // each constant takes 32 bits
+    uint32_t *array_of_constants = malloc(sizeof(uint32_t) * NUM_OF_PRIMES);
+    if(array_of_constants == NULL){
+        exit(1);
+        return NULL;
+    }
+
+    // we only take the fractional part of the cubic root of the constant
+    for(int i = 0; i < NUM_OF_PRIMES; ++i) {
+        // base = cubic root of the prime
+        double base = cbrt((double) primes[i]);
+        // base minus it's own fractional part
+        double fractional_part = base - floor(base);
+        // meking it equal
+        array_of_constants[i] = (uint32_t)(floor(fractional_part * (1ULL << 32)));
+    }
+
+    return array_of_constants;
+}
+
+// Initialize the hash values, same idea as the constants but with the square root of the first 8 primes
+uint32_t *initialize_hash_values(uint32_t *primes){
+    if(primes == NULL){
+        perror("the argument was NULL, in function initialize_hash_values");
+        exit(1);
+        return NULL;
+    }
+
+    uint32_t *hash_values = malloc(sizeof(uint32_t) * NUM_OF_HASH_VALUES);
+    if(hash_values == NULL){
+        exit(1);
+        return NULL;
+    }
+
+    for(int i = 0; i < NUM_OF_HASH_VALUES; ++i){
+        double base = sqrt((double) primes[i]);
+        double fractional_part = base - floor(base);
+        hash_values[i] = (uint32_t)(floor(fractional_part * (1ULL << 32)));
+    }
+
+    return hash_values;
+}
+
+#ifndef GEN_CONSTANTS_NO_MAIN
+// prints one table as a C array
+static void print_table(const char *name, const uint32_t *table, int count, int align){
+    printf("static _Alignas(%d) const uint32_t %s[%d] = {\n", align, name, count);
+    for(int i = 0; i < count; ++i){
+        printf("%s0x%08x,%s", i % 8 == 0 ? "    " : "", table[i], i % 8 == 7 || i == count - 1 ? "\n" : " ");
+    }
+    printf("};\n");
+}
+
+static uint32_t rotr(uint32_t x, int n){
+    return (x >> n) | (x << (32 - n));
+}
+
+// the block after a 64 byte message is always 0x80, zeros and 512 as the size, so its hole schedule is
+// known here, and it's written already added to K
+static void padding_schedule_64(const uint32_t *K, uint32_t wk[64]){
+    uint32_t w[64] = {0};
+    w[0] = 0x80000000u;
+    w[15] = 64 * 8;
+    for(int i = 16; i < 64; ++i){
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = s1 + w[i - 7] + s0 + w[i - 16];
+    }
+    for(int i = 0; i < 64; ++i){
+        wk[i] = w[i] + K[i];
+    }
+}
+
+int main(void){
+    uint32_t *primes = prime_arr_generator();
+    uint32_t *K = initialize_array_of_constants(primes);
+    uint32_t *H = initialize_hash_values(primes);
+
+    printf("/* generated by gen_constants, don't edit */\n");
+    printf("#ifndef SHA256_CONSTANTS_H\n#define SHA256_CONSTANTS_H\n\n#include <stdint.h>\n\n");
+    printf("// fractional part of the cubic root of the first %d primes, aligned to a cache line\n", NUM_OF_PRIMES);
+    print_table("sha256_K", K, NUM_OF_PRIMES, 64);
+    printf("\n// fractional part of the square root of the first %d primes\n", NUM_OF_HASH_VALUES);
+    print_table("sha256_H", H, NUM_OF_HASH_VALUES, 32);
+    uint32_t wk[64];
+    padding_schedule_64(K, wk);
+    printf("\n// K[i] + W[i] of the padding block of a 64 byte message\n");
+    print_table("sha256_pad64_wk", wk, 64, 64);
+    printf("\n#endif\n");
+
+    free(primes);
+    free(K);
+    free(H);
+    return 0;
+}
+#endif
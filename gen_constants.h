@@ -0,0 +1,20 @@
+#ifndef GEN_CONSTANTS_H
+#define GEN_CONSTANTS_H
+
+#include <stdint.h>
+
+/*
+ * File Description : the functions that compute the SHA-256 constants, used by the build time
+ * generator (and by the startup benchmark, to compare against the generated table)
+*/
+
+#define NUM_OF_PRIMES 64
+#define NUM_OF_HASH_VALUES 8
+
+// returns an array of all the first 64 prime numbers
+uint32_t *prime_arr_generator(void);
+// the round constants K, from the cubic root of the primes
+uint32_t *initialize_array_of_constants(uint32_t *primes);
+// the initial hash values, from the square root of the first 8 primes
+uint32_t *initialize_hash_values(uint32_t *primes);
+#endif
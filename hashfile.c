@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include "hashfile.h"
+#include "buffer.h"
+#include "stats.h"
+#include "stream.h"
+
+/*
+ * File Description : the ways a file can be read into the hasher, shared by the command line and the benchmarks
+*/
+
+// streams the file through the context, one chunk at a time
+int hash_file(const char *filename, uint8_t digest[SHA256_DIGEST_SIZE]){
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL){
+        fprintf(stderr, "ERROR OPENING FILE %s: ", filename);
+        perror("");
+        return -1;
+    }
+
+    // each worker has its own chunk, on its stack
+    uint8_t chunk[READ_CHUNK_SIZE];
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+
+    size_t read;
+    uint64_t total = 0;
+    stats_mark mark = stats_begin();
+    while((read = fread(chunk, 1, sizeof(chunk), file)) > 0){
+        stats_end(STATS_READ, mark);
+        mark = stats_begin();
+        sha256_update(&ctx, chunk, read);
+        total += read;
+        stats_end(STATS_HASH, mark);
+        mark = stats_begin();
+    }
+    stats_end(STATS_READ, mark);
+    if(ferror(file)){
+        fprintf(stderr, "fread failed at hash_file func, on %s\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    fclose(file);
+    mark = stats_begin();
+    sha256_final(&ctx, digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(total, stats_sha256_blocks(total));
+    return 0;
+}
+
+// hashes the file straight from the page cache, the only copy left is the last partial block
+int hash_file_mapped(const char *filename, uint8_t digest[SHA256_DIGEST_SIZE]){
+    stats_mark mark = stats_begin();
+    buf_t *buf = initBuf(filename);
+    // some files can't be mapped (or the system has no mmap), those are streamed
+    if(mapFile(buf) != 0){
+        freeBuf(buf);
+        return hash_file(filename, digest);
+    }
+    stats_end(STATS_READ, mark);
+
+    hash_buffer(buf, digest);
+
+    freeBuf(buf);
+    return 0;
+}
+
+// whole spans go to the context, so lines that are contiguous never get copied
+void hash_buffer(buf_t *buf, uint8_t digest[SHA256_DIGEST_SIZE]){
+    sha256_ctx ctx;
+    buf_span span;
+    stats_mark mark = stats_begin();
+    sha256_init(&ctx);
+    while(buffer_next_span(buf, &span)){
+        sha256_update(&ctx, span.ptr, span.len);
+    }
+    sha256_final(&ctx, digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(ctx.total_len, stats_sha256_blocks(ctx.total_len));
+}
+
+int hash_file_sha512(const char *filename, sha512_variant variant, uint8_t *digest){
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL){
+        fprintf(stderr, "ERROR OPENING FILE %s: ", filename);
+        perror("");
+        return -1;
+    }
+
+    uint8_t chunk[READ_CHUNK_SIZE];
+    sha512_ctx ctx;
+    sha512_init(&ctx, variant);
+
+    size_t read;
+    uint64_t total = 0;
+    stats_mark mark = stats_begin();
+    while((read = fread(chunk, 1, sizeof(chunk), file)) > 0){
+        stats_end(STATS_READ, mark);
+        mark = stats_begin();
+        sha512_update(&ctx, chunk, read);
+        total += read;
+        stats_end(STATS_HASH, mark);
+        mark = stats_begin();
+    }
+    stats_end(STATS_READ, mark);
+    if(ferror(file)){
+        fprintf(stderr, "fread failed at hash_file_sha512 func, on %s\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    fclose(file);
+    mark = stats_begin();
+    sha512_final(&ctx, digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(ctx.total_len, stats_sha512_blocks(ctx.total_len));
+    return 0;
+}
+
+int hash_file_sha512_mapped(const char *filename, sha512_variant variant, uint8_t *digest){
+    stats_mark mark = stats_begin();
+    buf_t *buf = initBuf(filename);
+    if(mapFile(buf) != 0){
+        freeBuf(buf);
+        return hash_file_sha512(filename, variant, digest);
+    }
+    stats_end(STATS_READ, mark);
+
+    // the page faults of the mapping are counted as hashing
+    mark = stats_begin();
+    sha512(variant, buf->lines[0].content, buf->file_size, digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(buf->file_size, stats_sha512_blocks(buf->file_size));
+
+    freeBuf(buf);
+    return 0;
+}
+
+// the ring hands the buffers over in order, each one goes straight to the context
+static void stream_sha256(const uint8_t *data, size_t len, void *ctx){
+    stats_mark mark = stats_begin();
+    sha256_update(ctx, data, len);
+    stats_end(STATS_HASH, mark);
+}
+
+static void stream_sha512(const uint8_t *data, size_t len, void *ctx){
+    stats_mark mark = stats_begin();
+    sha512_update(ctx, data, len);
+    stats_end(STATS_HASH, mark);
+}
+
+static void stream_hmac(const uint8_t *data, size_t len, void *ctx){
+    stats_mark mark = stats_begin();
+    hmac_sha256_update(ctx, data, len);
+    stats_end(STATS_HASH, mark);
+}
+
+int hash_stream(int fd, uint8_t digest[SHA256_DIGEST_SIZE]){
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    if(stream_fd(fd, stream_sha256, &ctx) != 0){
+        return -1;
+    }
+    stats_mark mark = stats_begin();
+    sha256_final(&ctx, digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(ctx.total_len, stats_sha256_blocks(ctx.total_len));
+    return 0;
+}
+
+int hmac_stream(int fd, const hmac_sha256_key *hkey, uint8_t mac[SHA256_DIGEST_SIZE]){
+    hmac_sha256_ctx ctx;
+    hmac_sha256_init(&ctx, hkey);
+    if(stream_fd(fd, stream_hmac, &ctx) != 0){
+        return -1;
+    }
+    stats_mark mark = stats_begin();
+    hmac_sha256_final(&ctx, mac);
+    stats_end(STATS_HASH, mark);
+    return 0;
+}
+
+int hash_stream_sha512(int fd, sha512_variant variant, uint8_t *digest){
+    sha512_ctx ctx;
+    sha512_init(&ctx, variant);
+    if(stream_fd(fd, stream_sha512, &ctx) != 0){
+        return -1;
+    }
+    stats_mark mark = stats_begin();
+    sha512_final(&ctx, digest);
+    stats_end(STATS_HASH, mark);
+    stats_message(ctx.total_len, stats_sha512_blocks(ctx.total_len));
+    return 0;
+}
@@ -0,0 +1,27 @@
+#ifndef HASHFILE_H
+#define HASHFILE_H
+
+#include <stdint.h>
+#include "sha256.h"
+#include "sha512.h"
+#include "hmac.h"
+#include "buffer.h"
+
+// size of the chunk read from the file each time, this is all the memory the hashing needs
+#define READ_CHUNK_SIZE (64 * 1024)
+
+// Streams the file through a context with fread, returns -1 if it can't be read
+int hash_file(const char *filename, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Hashes the file from a read only mapping, falls back to hash_file() when it can't be mapped
+int hash_file_mapped(const char *filename, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Hashes the buffer from its cursor to the end, a span at a time, works the same in text, binary or mapped mode
+void hash_buffer(buf_t *buf, uint8_t digest[SHA256_DIGEST_SIZE]);
+// The same two for the SHA-512 family, digest gets sha512_digest_size(variant) bytes
+int hash_file_sha512(const char *filename, sha512_variant variant, uint8_t *digest);
+int hash_file_sha512_mapped(const char *filename, sha512_variant variant, uint8_t *digest);
+// Hashes what comes from fd (stdin, a pipe) until it ends, read ahead by another thread, -1 on read errors
+int hash_stream(int fd, uint8_t digest[SHA256_DIGEST_SIZE]);
+int hash_stream_sha512(int fd, sha512_variant variant, uint8_t *digest);
+// The MAC of what comes from fd, read the same way
+int hmac_stream(int fd, const hmac_sha256_key *hkey, uint8_t mac[SHA256_DIGEST_SIZE]);
+#endif
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hmac.h"
+#include "sha256_kernels.h"
+#include "hashfile.h"
+#include "pool.h"
+
+/*
+ * File Description : HMAC and PBKDF2 on top of the midstates, the PBKDF2 loop doesn't go through the
+ * context at all: each iteration is exactly two compressions of a block that's already padded
+*/
+
+#define HMAC_IPAD 0x36
+#define HMAC_OPAD 0x5c
+
+// a 32 byte message after the 64 byte pad block: the digest, 0x80, zeros and 96 * 8 = 768 bits as the size,
+// only the first 32 bytes change from one iteration to the next
+static const uint8_t digest_block_padding[SHA256_BLOCK_SIZE - SHA256_DIGEST_SIZE] = {
+    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x03, 0x00,
+};
+
+// one pad block compressed from the initial hash values
+static void pad_midstate(const uint8_t key_block[SHA256_BLOCK_SIZE], uint8_t pad, sha256_midstate *mid){
+    uint8_t block[SHA256_BLOCK_SIZE];
+    sha256_ctx ctx;
+    for(int i = 0; i < SHA256_BLOCK_SIZE; ++i){
+        block[i] = key_block[i] ^ pad;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, block, SHA256_BLOCK_SIZE);
+    sha256_export_midstate(&ctx, mid);
+}
+
+void hmac_sha256_set_key(hmac_sha256_key *hkey, const void *key, size_t key_len){
+    uint8_t key_block[SHA256_BLOCK_SIZE] = {0};
+    if(key_len > SHA256_BLOCK_SIZE){
+        sha256(key, key_len, key_block);
+    }else if(key_len > 0){
+        memcpy(key_block, key, key_len);
+    }
+    pad_midstate(key_block, HMAC_IPAD, &hkey->inner);
+    pad_midstate(key_block, HMAC_OPAD, &hkey->outer);
+}
+
+void hmac_sha256_init(hmac_sha256_ctx *ctx, const hmac_sha256_key *hkey){
+    ctx->key = hkey;
+    sha256_import_midstate(&ctx->inner, &hkey->inner);
+}
+
+void hmac_sha256_update(hmac_sha256_ctx *ctx, const void *data, size_t len){
+    sha256_update(&ctx->inner, data, len);
+}
+
+// the outer hash only ever sees the 32 byte inner digest, so it's a single block already padded
+void hmac_sha256_final(hmac_sha256_ctx *ctx, uint8_t mac[SHA256_DIGEST_SIZE]){
+    uint8_t block[SHA256_BLOCK_SIZE];
+    uint32_t hash[8];
+    sha256_final(&ctx->inner, block);
+    memcpy(&block[SHA256_DIGEST_SIZE], digest_block_padding, sizeof(digest_block_padding));
+    memcpy(hash, ctx->key->outer.hash, sizeof(hash));
+    sha256_compress_blocks(hash, block, 1);
+    sha256_store_digest(hash, mac);
+}
+
+void hmac_sha256_keyed(const hmac_sha256_key *hkey, const void *data, size_t len, uint8_t mac[SHA256_DIGEST_SIZE]){
+    hmac_sha256_ctx ctx;
+    hmac_sha256_init(&ctx, hkey);
+    hmac_sha256_update(&ctx, data, len);
+    hmac_sha256_final(&ctx, mac);
+}
+
+void hmac_sha256(const void *key, size_t key_len, const void *data, size_t len, uint8_t mac[SHA256_DIGEST_SIZE]){
+    hmac_sha256_key hkey;
+    hmac_sha256_set_key(&hkey, key, key_len);
+    hmac_sha256_keyed(&hkey, data, len, mac);
+}
+
+int hmac_sha256_file(const hmac_sha256_key *hkey, const char *filename, uint8_t mac[SHA256_DIGEST_SIZE]){
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL){
+        fprintf(stderr, "ERROR OPENING FILE %s: ", filename);
+        perror("");
+        return -1;
+    }
+
+    uint8_t chunk[READ_CHUNK_SIZE];
+    hmac_sha256_ctx ctx;
+    hmac_sha256_init(&ctx, hkey);
+
+    size_t read;
+    while((read = fread(chunk, 1, sizeof(chunk), file)) > 0){
+        hmac_sha256_update(&ctx, chunk, read);
+    }
+    if(ferror(file)){
+        fprintf(stderr, "fread failed at hmac_sha256_file func, on %s\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    fclose(file);
+    hmac_sha256_final(&ctx, mac);
+    return 0;
+}
+
+// what the PBKDF2 block tasks share
+typedef struct Pbkdf2_job {
+    hmac_sha256_key key;
+    const uint8_t *salt;
+    size_t salt_len;
+    uint32_t iterations;
+    uint8_t *out;
+    size_t out_len;
+} pbkdf2_job;
+
+// T_i = U_1 ^ U_2 ^ ... ^ U_c, U_1 = HMAC(P, S || INT(i)) and U_j = HMAC(P, U_j-1)
+static void pbkdf2_block(size_t index, void *arg){
+    pbkdf2_job *job = arg;
+    uint8_t counter[4];
+    uint32_t number = (uint32_t)index + 1;
+    for(int i = 0; i < 4; ++i){
+        counter[i] = (number >> ((3 - i) * 8)) & 0xFF;
+    }
+
+    // the first one has the salt, it goes through the context like any other message
+    uint8_t block[SHA256_BLOCK_SIZE];
+    hmac_sha256_ctx ctx;
+    hmac_sha256_init(&ctx, &job->key);
+    hmac_sha256_update(&ctx, job->salt, job->salt_len);
+    hmac_sha256_update(&ctx, counter, sizeof(counter));
+    hmac_sha256_final(&ctx, block);
+
+    uint8_t t[SHA256_DIGEST_SIZE];
+    memcpy(t, block, SHA256_DIGEST_SIZE);
+    memcpy(&block[SHA256_DIGEST_SIZE], digest_block_padding, sizeof(digest_block_padding));
+
+    // the rest are 32 bytes long, block keeps U_j-1 in front of the padding the hole time,
+    // the inner digest is written over it and then the outer one
+    uint32_t hash[8];
+    for(uint32_t j = 1; j < job->iterations; ++j){
+        memcpy(hash, job->key.inner.hash, sizeof(hash));
+        sha256_compress_blocks(hash, block, 1);
+        sha256_store_digest(hash, block);
+
+        memcpy(hash, job->key.outer.hash, sizeof(hash));
+        sha256_compress_blocks(hash, block, 1);
+        sha256_store_digest(hash, block);
+
+        for(int i = 0; i < SHA256_DIGEST_SIZE; ++i){
+            t[i] ^= block[i];
+        }
+    }
+
+    // the last block of the output can be shorter
+    size_t offset = index * SHA256_DIGEST_SIZE;
+    size_t take = job->out_len - offset < SHA256_DIGEST_SIZE ? job->out_len - offset : SHA256_DIGEST_SIZE;
+    memcpy(&job->out[offset], t, take);
+}
+
+int pbkdf2_hmac_sha256(const void *password, size_t password_len, const void *salt, size_t salt_len,
+                       uint32_t iterations, uint8_t *out, size_t out_len, int workers){
+    if(iterations == 0){
+        return -1;
+    }
+    if(out_len == 0){
+        return 0;
+    }
+
+    pbkdf2_job job = { .salt = salt, .salt_len = salt_len, .iterations = iterations, .out = out, .out_len = out_len };
+    hmac_sha256_set_key(&job.key, password, password_len);
+
+    size_t blocks = (out_len + SHA256_DIGEST_SIZE - 1) / SHA256_DIGEST_SIZE;
+    if(blocks == 1 || workers <= 1){
+        for(size_t i = 0; i < blocks; ++i){
+            pbkdf2_block(i, &job);
+        }
+        return 0;
+    }
+    return pool_run(workers < (int)blocks ? workers : (int)blocks, blocks, NULL, pbkdf2_block, &job);
+}
+
+// the expected results from the RFCs
+typedef struct Hmac_vector {
+    const char *key;
+    size_t key_len;
+    const char *data;
+    const char *mac;
+} hmac_vector;
+
+int hmac_self_test(void){
+    int failures = 0;
+    char key_0b[20], key_aa[131];
+    memset(key_0b, 0x0b, sizeof(key_0b));
+    memset(key_aa, 0xaa, sizeof(key_aa));
+    // RFC 4231 cases 1, 2 and 6 (a key longer than the block)
+    const hmac_vector vectors[] = {
+        { key_0b, sizeof(key_0b), "Hi There",
+          "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+        { "Jefe", 4, "what do ya want for nothing?",
+          "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+        { key_aa, sizeof(key_aa), "Test Using Larger Than Block-Size Key - Hash Key First",
+          "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+    };
+    for(size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i){
+        uint8_t mac[SHA256_DIGEST_SIZE];
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        hmac_sha256(vectors[i].key, vectors[i].key_len, vectors[i].data, strlen(vectors[i].data), mac);
+        sha256_hex(mac, hex);
+        if(strcmp(hex, vectors[i].mac) != 0){
+            failures++;
+        }
+    }
+
+    // RFC 7914 section 11, 64 bytes is two output blocks so the threaded path runs too
+    static const uint8_t expected_1[64] = {
+        0x55, 0xac, 0x04, 0x6e, 0x56, 0xe3, 0x08, 0x9f, 0xec, 0x16, 0x91, 0xc2, 0x25, 0x44, 0xb6, 0x05,
+        0xf9, 0x41, 0x85, 0x21, 0x6d, 0xde, 0x04, 0x65, 0xe6, 0x8b, 0x9d, 0x57, 0xc2, 0x0d, 0xac, 0xbc,
+        0x49, 0xca, 0x9c, 0xcc, 0xf1, 0x79, 0xb6, 0x45, 0x99, 0x16, 0x64, 0xb3, 0x9d, 0x77, 0xef, 0x31,
+        0x7c, 0x71, 0xb8, 0x45, 0xb1, 0xe3, 0x0b, 0xd5, 0x09, 0x11, 0x20, 0x41, 0xd3, 0xa1, 0x97, 0x83,
+    };
+    static const uint8_t expected_80000[64] = {
+        0x4d, 0xdc, 0xd8, 0xf6, 0x0b, 0x98, 0xbe, 0x21, 0x83, 0x0c, 0xee, 0x5e, 0xf2, 0x27, 0x01, 0xf9,
+        0x64, 0x1a, 0x44, 0x18, 0xd0, 0x4c, 0x04, 0x14, 0xae, 0xff, 0x08, 0x87, 0x6b, 0x34, 0xab, 0x56,
+        0xa1, 0xd4, 0x25, 0xa1, 0x22, 0x58, 0x33, 0x54, 0x9a, 0xdb, 0x84, 0x1b, 0x51, 0xc9, 0xb3, 0x17,
+        0x6a, 0x27, 0x2b, 0xde, 0xbb, 0xa1, 0xd0, 0x78, 0x47, 0x8f, 0x62, 0xb3, 0x97, 0xf3, 0x3c, 0x8d,
+    };
+    uint8_t derived[64];
+    if(pbkdf2_hmac_sha256("passwd", 6, "salt", 4, 1, derived, sizeof(derived), 2) != 0 ||
+       memcmp(derived, expected_1, sizeof(derived)) != 0){
+        failures++;
+    }
+    if(pbkdf2_hmac_sha256("Password", 8, "NaCl", 4, 80000, derived, sizeof(derived), 2) != 0 ||
+       memcmp(derived, expected_80000, sizeof(derived)) != 0){
+        failures++;
+    }
+
+    printf("self-test: %-8s %s\n", "hmac", failures ? "FAILED" : "OK");
+    return failures == 0 ? 0 : -1;
+}
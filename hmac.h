@@ -0,0 +1,45 @@
+#ifndef HMAC_H
+#define HMAC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : HMAC-SHA256 (RFC 2104) and PBKDF2-HMAC-SHA256 (RFC 8018)
+ * the key is only hashed once: the blocks key^ipad and key^opad are compressed when the key is set
+ * and kept as midstates, every MAC after that starts from them instead of hashing the pads again
+*/
+
+// the key already turned into the two midstates
+typedef struct Hmac_sha256_key {
+    sha256_midstate inner;
+    sha256_midstate outer;
+} hmac_sha256_key;
+
+// streaming HMAC, the message goes to the inner hash
+typedef struct Hmac_sha256_ctx {
+    sha256_ctx inner;
+    const hmac_sha256_key *key;
+} hmac_sha256_ctx;
+
+// Compresses the ipad and opad blocks of the key, keys longer than 64 bytes are hashed first
+SHA256_API void hmac_sha256_set_key(hmac_sha256_key *hkey, const void *key, size_t key_len);
+// the key has to stay alive until hmac_sha256_final()
+SHA256_API void hmac_sha256_init(hmac_sha256_ctx *ctx, const hmac_sha256_key *hkey);
+SHA256_API void hmac_sha256_update(hmac_sha256_ctx *ctx, const void *data, size_t len);
+SHA256_API void hmac_sha256_final(hmac_sha256_ctx *ctx, uint8_t mac[SHA256_DIGEST_SIZE]);
+// One shot versions
+SHA256_API void hmac_sha256_keyed(const hmac_sha256_key *hkey, const void *data, size_t len, uint8_t mac[SHA256_DIGEST_SIZE]);
+SHA256_API void hmac_sha256(const void *key, size_t key_len, const void *data, size_t len, uint8_t mac[SHA256_DIGEST_SIZE]);
+// Streams the file into the MAC, -1 if it can't be read
+SHA256_API int hmac_sha256_file(const hmac_sha256_key *hkey, const char *filename, uint8_t mac[SHA256_DIGEST_SIZE]);
+
+// Derives out_len bytes, the 32 byte blocks of the output don't depend on each other so they're split
+// between workers threads, returns -1 if iterations is 0 or the threads couldn't be created
+SHA256_API int pbkdf2_hmac_sha256(const void *password, size_t password_len, const void *salt, size_t salt_len,
+                       uint32_t iterations, uint8_t *out, size_t out_len, int workers);
+
+// Checks against the RFC 4231 and RFC 7914 vectors, prints the result, 0 when everything matched
+int hmac_self_test(void);
+#endif
@@ -0,0 +1,18 @@
+#ifndef LIBSHA256_H
+#define LIBSHA256_H
+
+/*
+ * File Description : the one header for the programs that link libsha256.a or libsha256.so
+ * sha256.h           streaming and one shot SHA-256, midstates, kernel selection
+ * sha256_mb.h        the multi buffer engine
+ * batch.h            many messages in one call, routed to the fastest engine
+ * sha512.h           SHA-512, SHA-384 and SHA-512/256
+ * hmac.h             HMAC-SHA256 and PBKDF2
+*/
+
+#include "sha256.h"
+#include "sha256_mb.h"
+#include "batch.h"
+#include "sha512.h"
+#include "hmac.h"
+#endif
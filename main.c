@@ -1,294 +1,1058 @@
 #include <stdio.h>
-#include <math.h>
 #include <stdlib.h>
-#include <stdarg.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
 #include "buffer.h"
+#include "sha256.h"
+#include "sha256_mb.h"
+#include "pool.h"
+#include "uring.h"
+#include "tree.h"
+#include "hashfile.h"
+#include "cache.h"
+#include "walk.h"
+#include "hmac.h"
+#include "sha512.h"
+#include "stats.h"
+#include "batch.h"
+#include "merkle.h"
+#include "cdc.h"
+#include "daemon.h"
+#include "checkpoint.h"
+
+// files being read at the same time by each worker, with --io-uring
+#define URING_DEPTH 32
+
+// how the inputs are read, set by the command line
+typedef struct Hash_options {
+    // hashes regular files straight from a read only mapping
+    bool use_mmap;
+    // reads the files through io_uring, many of them at once per worker
+    bool use_uring;
+    // --tree, the chunk size of the tree hash, 0 is the normal SHA-256
+    size_t tree_chunk;
+    // --cache, digests of files that didn't change are taken from here
+    digest_cache *cache;
+    // -a, one of the SHA-512 family instead of SHA-256
+    bool use_sha512;
+    sha512_variant variant;
+    // --checkpoint, the midstate is saved next to the file every this many bytes, 0 is off
+    size_t checkpoint_interval;
+    // --resume, files with a valid checkpoint carry on from it
+    bool resume;
+} hash_options;
+
+// one argument of the command line, and what came out of it
+typedef struct Hash_job {
+    const char *arg;
+    // big enough for any algorithm, digest_size() bytes are used
+    uint8_t digest[SHA512_DIGEST_SIZE];
+    // 0 when the digest is valid
+    int status;
+    // set by the worker, the printing only goes forward when the next job is done
+    bool done;
+    // -c mode, arg is a path from a manifest and the digest is compared to expected
+    bool check;
+    bool matched;
+    uint8_t expected[SHA512_DIGEST_SIZE];
+    // the size of the file, the check mode starts by the biggest ones
+    uint64_t size;
+    // the identity of the file when the hashing started, for the cache
+    cache_key key;
+    bool has_key;
+} hash_job;
+
+// a list of jobs that grows while the arguments and manifests are read
+typedef struct Job_list {
+    hash_job *jobs;
+    size_t count;
+    size_t capacity;
+} job_list;
+
+// shared by every worker
+typedef struct Hash_run {
+    hash_job *jobs;
+    size_t count;
+    // the first job that wasn't printed yet
+    size_t next_print;
+    pthread_mutex_t print_lock;
+    const hash_options *options;
+    // the order the jobs are started in (NULL is the argument order), and how many workers share them
+    const size_t *order;
+    int workers;
+} hash_run;
+
+// the files one worker sends to its ring, positions maps them back to the jobs
+typedef struct Uring_batch {
+    hash_run *run;
+    size_t *positions;
+} uring_batch;
 
-#define NUM_OF_PRIMES 64 
-
-/* HASH VALUES */	
-#define h0 0x6a09e667 // 2
-#define h1 0xbb67ae85 // 3
-#define h2 0x3c6ef372 // 5
-#define h3 0xa54ff53a // 7
-#define h4 0x510e527f // 11
-#define h5 0x9b05688c // 13
-#define h6 0x1f83d9ab // 17
-#define h7 0x5be0cd19 // 19
-
-// binary = 1000, dec = 8
-#define BIT_1 0x80
-// binary = 0000, dec = 0
-#define BIT_0 0x00
-
-// macro to implement right rotation
-//#define right_rotate_asm(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
- 
 // functions declarations
-void free_easy(void *first, ...);
-uint32_t *prime_arr_generator(void);
-uint32_t *initialize_array_of_constants(uint32_t *primes);
-void compress(uint32_t *w, uint32_t *hash, const uint32_t *K);
-void process(uint8_t *processed_data, uint32_t *w);
-uint8_t *padding(buf_t *buf);
-
-#ifdef _WIN32
-// Windows version (no GCC-style inline assembly)
-// Use pure C version
-#define right_rotate_asm(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
-#else
-// Linux, WSL, Mac (GCC/Clang)
-static inline uint32_t right_rotate_asm(uint32_t x, uint32_t n){
-    __asm__("rorl %1, %0"
-            : "+r" (x)
-            : "cI" (n)
-            );
-    return x;
-}
-#define RIGHT_ROTATE(x,n) right_rotate_asm((x),(n))
-#endif
+int hash_argument(const char *arg, const hash_options *options, uint8_t *digest);
+int hash_path(const char *path, const hash_options *options, uint8_t *digest);
+int hash_contents(const char *path, const hash_options *options, uint8_t *digest);
+int hash_stdin(const hash_options *options, uint8_t *digest);
+size_t digest_size(const hash_options *options);
+void digest_hex(const uint8_t *digest, size_t size, char *out);
+int cache_find(digest_cache *cache, const char *path, cache_key *key, uint8_t digest[SHA256_DIGEST_SIZE]);
+void cache_remember(digest_cache *cache, const char *path, const cache_key *key, const uint8_t digest[SHA256_DIGEST_SIZE]);
+void hash_task(size_t index, void *ctx);
+void job_finished(hash_run *run, hash_job *job);
+void uring_task(size_t worker, void *ctx);
+void uring_job_done(size_t index, int status, const uint8_t digest[SHA256_DIGEST_SIZE], void *ctx);
+void print_usage(const char *name);
+hash_job *job_add(job_list *list, const char *arg);
+int load_manifest(const char *manifest, size_t size, job_list *list, buf_t **buf, size_t *malformed);
+size_t *largest_first(hash_job *jobs, size_t count);
+int parse_size(const char *value, size_t *size);
+int tree_main(const char *const *paths, size_t count, size_t chunk, int workers);
+int merkle_main(const char *const *paths, size_t count, size_t record_size, const size_t *proofs, size_t nproofs,
+                int workers);
+int cdc_main(const char *const *paths, size_t count, int workers);
+int recursive_main(const char *const *paths, size_t count, int workers, const hash_options *options, bool summary);
+int walk_hash(const char *path, uint8_t digest[SHA256_DIGEST_SIZE], void *ctx);
+int hmac_main(const char *const *args, size_t count, const char *key);
+int pbkdf2_main(const char *const *passwords, size_t count, const char *salt, uint32_t iterations, size_t length, int workers);
 
 int main(int argc, char *argv[]){
-    if(argc != 2){
-        fprintf(stderr, "USAGE: %s <filename or string>\n", argv[0]);
+    // without arguments the input is stdin, like sha256sum, unless it's a terminal
+    if(argc < 2 && isatty(STDIN_FILENO)){
+        print_usage(argv[0]);
         return EXIT_FAILURE;
     }
 
-    buf_t *buf = NULL;
+    sha256_setup();
 
-    // Try to open as a file first
-    struct stat st;
-    if(stat(argv[1], &st) == 0 && S_ISREG(st.st_mode)){
-        // Is a real file
-        buf = initBuf(argv[1]);
-        readFile(buf, 1); // binary mode
-    }else{
-        // Not a file → treat as string
-        buf = buf_string(argv[1]);
+    // checks the runtime selected kernel against the portable one
+    if(argc > 1 && strcmp(argv[1], "--self-test") == 0){
+        int failed = sha256_self_test() != 0;
+        failed |= sha256_mb_self_test() != 0;
+        failed |= hmac_self_test() != 0;
+        failed |= sha512_self_test() != 0;
+        failed |= buffer_blocks_self_test() != 0;
+        failed |= sha256_batch_self_test() != 0;
+        failed |= merkle_self_test() != 0;
+        failed |= cdc_self_test() != 0;
+        failed |= checkpoint_self_test() != 0;
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    int workers = pool_default_workers();
+    hash_options options = { .use_mmap = false, .use_uring = false, .tree_chunk = 0, .cache = NULL,
+                             .use_sha512 = false, .variant = SHA512_VARIANT_512, .checkpoint_interval = 0,
+                             .resume = false };
+    const char *cache_path = NULL;
+    bool check_mode = false;
+    bool recursive = false;
+    bool summary = false;
+    // --hmac and --pbkdf2, the other modes are off when one of them is set
+    const char *hmac_key = NULL;
+    const char *pbkdf2_salt = NULL;
+    uint32_t pbkdf2_iterations = 0;
+    size_t pbkdf2_length = SHA256_DIGEST_SIZE;
+    // --merkle, a leaf per line, or per record when record_size isn't 0, and the leaves to prove
+    bool merkle = false;
+    // --cdc, content defined chunks and their digests
+    bool cdc = false;
+    // --daemon serves on the socket, --client sends the arguments to it
+    const char *daemon_socket = NULL;
+    const char *client_socket = NULL;
+    bool send_fds = false;
+    size_t record_size = 0;
+    size_t *proofs = malloc(sizeof(size_t) * argc);
+    size_t proof_count = 0;
+    job_list list = { NULL, 0, 0 };
+    // the arguments that aren't options, only used after everything was parsed
+    const char **operands = malloc(sizeof(char *) * argc);
+    if(operands == NULL || proofs == NULL){
+        perror("malloc failed, in function main");
+        free(operands);
+        free(proofs);
+        return EXIT_FAILURE;
+    }
+    size_t operand_count = 0;
+    bool options_over = false;
+
+    for(int i = 1; i < argc; ++i){
+        const char *arg = argv[i];
+        if(!options_over && strcmp(arg, "--") == 0){
+            options_over = true;
+        }else if(!options_over && strcmp(arg, "--mmap") == 0){
+            options.use_mmap = true;
+        }else if(!options_over && strcmp(arg, "--io-uring") == 0){
+            options.use_uring = true;
+        }else if(!options_over && strncmp(arg, "--tree", 6) == 0 && (arg[6] == '\0' || arg[6] == '=')){
+            // --tree or --tree=SIZE, with an optional K, M or G
+            options.tree_chunk = TREE_DEFAULT_CHUNK;
+            if(arg[6] == '=' && (parse_size(&arg[7], &options.tree_chunk) != 0 || options.tree_chunk == 0)){
+                fprintf(stderr, "INVALID TREE CHUNK SIZE: %s\n", &arg[7]);
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+        }else if(!options_over && strncmp(arg, "--checkpoint", 12) == 0 && (arg[12] == '\0' || arg[12] == '=')){
+            // --checkpoint or --checkpoint=SIZE, the bytes between two saves
+            options.checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+            if(arg[12] == '=' && (parse_size(&arg[13], &options.checkpoint_interval) != 0 || options.checkpoint_interval == 0)){
+                fprintf(stderr, "INVALID CHECKPOINT INTERVAL: %s\n", &arg[13]);
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+        }else if(!options_over && strcmp(arg, "--resume") == 0){
+            options.resume = true;
+        }else if(!options_over && strcmp(arg, "--merkle") == 0){
+            merkle = true;
+        }else if(!options_over && strcmp(arg, "--cdc") == 0){
+            cdc = true;
+        }else if(!options_over && strcmp(arg, "--daemon") == 0 && i + 1 < argc){
+            daemon_socket = argv[++i];
+        }else if(!options_over && strcmp(arg, "--client") == 0 && i + 1 < argc){
+            client_socket = argv[++i];
+        }else if(!options_over && strcmp(arg, "--send-fd") == 0){
+            send_fds = true;
+        }else if(!options_over && strcmp(arg, "--record-size") == 0 && i + 1 < argc){
+            if(parse_size(argv[++i], &record_size) != 0 || record_size == 0){
+                fprintf(stderr, "INVALID RECORD SIZE: %s\n", argv[i]);
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+        }else if(!options_over && strcmp(arg, "--proof") == 0 && i + 1 < argc){
+            char *end = NULL;
+            unsigned long long index = strtoull(argv[++i], &end, 10);
+            if(*end != '\0' || end == argv[i]){
+                fprintf(stderr, "INVALID LEAF INDEX: %s\n", argv[i]);
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+            proofs[proof_count++] = (size_t)index;
+        }else if(!options_over && strcmp(arg, "--cache") == 0 && i + 1 < argc){
+            cache_path = argv[++i];
+        }else if(!options_over && strncmp(arg, "--cache=", 8) == 0){
+            cache_path = &arg[8];
+        }else if(!options_over && strcmp(arg, "-r") == 0){
+            recursive = true;
+        }else if(!options_over && strcmp(arg, "--summary") == 0){
+            summary = true;
+        }else if(!options_over && strcmp(arg, "--hmac") == 0 && i + 1 < argc){
+            hmac_key = argv[++i];
+        }else if(!options_over && strcmp(arg, "--pbkdf2") == 0 && i + 2 < argc){
+            pbkdf2_salt = argv[++i];
+            char *end = NULL;
+            unsigned long iterations = strtoul(argv[++i], &end, 10);
+            if(*end != '\0' || iterations == 0 || iterations > UINT32_MAX){
+                fprintf(stderr, "INVALID NUMBER OF ITERATIONS: %s\n", argv[i]);
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+            pbkdf2_iterations = (uint32_t)iterations;
+        }else if(!options_over && strcmp(arg, "--dklen") == 0 && i + 1 < argc){
+            if(parse_size(argv[++i], &pbkdf2_length) != 0 || pbkdf2_length == 0){
+                fprintf(stderr, "INVALID KEY LENGTH: %s\n", argv[i]);
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+        }else if(!options_over && strcmp(arg, "-a") == 0 && i + 1 < argc){
+            // sha256 (the default), sha512, sha384 or sha512-256
+            const char *name = argv[++i];
+            options.use_sha512 = strcmp(name, "sha256") != 0 && strcmp(name, "256") != 0;
+            if(options.use_sha512 && sha512_variant_from_name(name, &options.variant) != 0){
+                fprintf(stderr, "UNKNOWN ALGORITHM: %s\n", name);
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+        }else if(!options_over && (strcmp(arg, "--stats") == 0 || strcmp(arg, "--stats=text") == 0)){
+            stats_enable(STATS_TEXT);
+        }else if(!options_over && strcmp(arg, "--stats=json") == 0){
+            stats_enable(STATS_JSON);
+        }else if(!options_over && strcmp(arg, "-c") == 0){
+            check_mode = true;
+        }else if(!options_over && strncmp(arg, "-j", 2) == 0){
+            // accepts both -j 4 and -j4
+            const char *value = arg[2] != '\0' ? &arg[2] : (i + 1 < argc ? argv[++i] : NULL);
+            char *end = NULL;
+            long j = value ? strtol(value, &end, 10) : 0;
+            if(value == NULL || *end != '\0' || j < 1){
+                fprintf(stderr, "INVALID NUMBER OF WORKERS: %s\n", value ? value : "(missing)");
+                free(operands);
+                free(proofs);
+                return EXIT_FAILURE;
+            }
+            workers = (int)j;
+        }else{
+            operands[operand_count++] = arg;
+        }
+    }
+
+    // the daemon has no operands, it runs until it's stopped
+    if(daemon_socket != NULL){
+        if(options.use_sha512){
+            fprintf(stderr, "the daemon only answers with SHA-256\n");
+        }
+        int failed = options.use_sha512 || daemon_serve(daemon_socket, workers) != 0;
+        free(operands);
+        free(proofs);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
     }
 
-    if(!buf){
-        fprintf(stderr, "FAILED TO INITIALIZE BUFFER\n");
+    // the modes that read "-" as stdin, the others take files they can seek in or map, --pbkdf2 takes passwords
+    bool stdin_mode = !(options.tree_chunk > 0 || recursive || pbkdf2_salt != NULL);
+    if(operand_count == 0 && stdin_mode && !isatty(STDIN_FILENO)){
+        operands[operand_count++] = "-";
+    }
+    if(operand_count == 0){
+        print_usage(argv[0]);
+        free(operands);
+        free(proofs);
         return EXIT_FAILURE;
     }
+    for(size_t i = 0; i < operand_count && pbkdf2_salt == NULL && !stdin_mode; ++i){
+        if(strcmp(operands[i], "-") == 0){
+            fprintf(stderr, "- (stdin) only works on the normal, -c, --hmac, --merkle, --cdc and --client modes\n");
+            free(operands);
+            free(proofs);
+            return EXIT_FAILURE;
+        }
+    }
 
-    uint8_t *data = padding(buf);
-    if(!data){
-        fprintf(stderr, "ERROR IN PADDING.\n");
-        freeBuf(buf);
+    // the other modes are SHA-256 only
+    if(options.use_sha512 && (hmac_key != NULL || pbkdf2_salt != NULL || options.tree_chunk > 0 || recursive || merkle || cdc
+                              || client_socket != NULL)){
+        fprintf(stderr, "-a %s only works on the normal and the -c modes\n", sha512_variant_name(options.variant));
+        free(operands);
+        free(proofs);
+        return EXIT_FAILURE;
+    }
+    // resuming goes on saving, with the default interval unless one was given
+    if(options.resume && options.checkpoint_interval == 0){
+        options.checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+    }
+    // the midstate is a SHA-256 one, and only the plain hash of a whole file is read in order
+    if(options.checkpoint_interval > 0 && (options.use_sha512 || hmac_key != NULL || pbkdf2_salt != NULL ||
+                                           options.tree_chunk > 0 || merkle || cdc || client_socket != NULL)){
+        fprintf(stderr, "--checkpoint and --resume only work with SHA-256 on the normal, -c and -r modes\n");
+        free(operands);
+        free(proofs);
+        return EXIT_FAILURE;
+    }
+    if(!merkle && (record_size > 0 || proof_count > 0)){
+        fprintf(stderr, "--record-size and --proof only work with --merkle\n");
+        free(operands);
+        free(proofs);
         return EXIT_FAILURE;
     }
 
-    uint32_t hash[8] = { h0, h1, h2, h3, h4, h5, h6, h7 };
-    uint32_t *primes = prime_arr_generator();
-    uint32_t *K = initialize_array_of_constants(primes);
+    // the leaves of each file are split between the workers
+    if(merkle){
+        int failed = merkle_main(operands, operand_count, record_size, proofs, proof_count, workers);
+        free(operands);
+        free(proofs);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    free(proofs);
+
+    // the daemon does the hashing, this only sends and prints
+    if(client_socket != NULL){
+        int failed = daemon_client(client_socket, operands, operand_count, send_fds) != 0;
+        free(operands);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
 
-    if(!primes || !K){
-        fprintf(stderr, "ERROR GENERATING CONSTANTS\n");
-        freeBuf(buf);
+    // the chunks of each file are hashed by the workers while the next cuts are found
+    if(cdc){
+        int failed = cdc_main(operands, operand_count, workers);
+        free(operands);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // the keyed modes only print their own labeled lines
+    if(hmac_key != NULL || pbkdf2_salt != NULL){
+        int failed = hmac_key != NULL ? hmac_main(operands, operand_count, hmac_key)
+                                      : pbkdf2_main(operands, operand_count, pbkdf2_salt, pbkdf2_iterations, pbkdf2_length, workers);
+        free(operands);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // the tree hash takes one file at a time, and splits it between the workers
+    if(options.tree_chunk > 0){
+        int failed = tree_main(operands, operand_count, options.tree_chunk, workers);
+        free(operands);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // a cache that can't be opened only makes the run slower, it isn't an error
+    if(cache_path != NULL && options.use_sha512){
+        fprintf(stderr, "the cache only keeps SHA-256 digests, running without it\n");
+    }else if(cache_path != NULL){
+        options.cache = cache_open(cache_path);
+        if(options.cache == NULL){
+            fprintf(stderr, "running without the cache\n");
+        }
+    }
+
+    // the directories are walked one at a time, each one by all the workers
+    if(recursive){
+        int failed = recursive_main(operands, operand_count, workers, &options, summary);
+        cache_close(options.cache);
+        free(operands);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // every manifest stays loaded until the end, the jobs point to its lines
+    buf_t **manifests = calloc(operand_count, sizeof(buf_t *));
+    size_t malformed = 0;
+    int result = 0;
+    if(manifests == NULL){
+        perror("calloc failed, in function main");
+        free(operands);
         return EXIT_FAILURE;
     }
+    for(size_t i = 0; i < operand_count; ++i){
+        if(check_mode){
+            if(load_manifest(operands[i], digest_size(&options), &list, &manifests[i], &malformed) != 0){
+                result = -1;
+            }
+        }else{
+            job_add(&list, operands[i]);
+        }
+    }
 
-    for(size_t offset = 0; offset < buf->file_size; offset += 64){
-        uint32_t w[64];
-        process(&data[offset], w);
-        compress(w, hash, K);
+    // the check mode starts by the biggest files, so the small ones fill the gaps at the end
+    size_t *order = check_mode ? largest_first(list.jobs, list.count) : NULL;
+
+    // kernels without io_uring keep the stdio path
+    if(options.use_uring && !uring_available()){
+        fprintf(stderr, "io_uring is not available, reading with stdio\n");
+        options.use_uring = false;
+    }
+    // the ring hashes with SHA-256 as the chunks arrive
+    if(options.use_uring && options.use_sha512){
+        options.use_uring = false;
+    }
+    // and so does a checkpointed file, which has to be read in order from one place
+    if(options.use_uring && options.checkpoint_interval > 0){
+        options.use_uring = false;
     }
 
-    for(int i = 0; i < 8; ++i){
-        printf("%08x", hash[i]);
+    hash_run run = { .jobs = list.jobs, .count = list.count, .next_print = 0, .options = &options,
+                     .order = order, .workers = workers };
+    pthread_mutex_init(&run.print_lock, NULL);
+    if(options.use_uring){
+        // one task per worker, each one with its own ring
+        if((size_t)run.workers > list.count){
+            run.workers = list.count ? (int)list.count : 1;
+        }
+        if(pool_run(run.workers, run.workers, NULL, uring_task, &run) != 0){
+            result = -1;
+        }
+    }else if(pool_run(workers, list.count, order, hash_task, &run) != 0){
+        result = -1;
     }
+    pthread_mutex_destroy(&run.print_lock);
 
-    printf("  %s\n", argv[1]);
+    size_t unreadable = 0, mismatched = 0;
+    for(size_t i = 0; i < list.count; ++i){
+        if(list.jobs[i].status != 0){
+            unreadable++;
+        }else if(list.jobs[i].check && !list.jobs[i].matched){
+            mismatched++;
+        }
+    }
+    // same warnings as sha256sum
+    if(malformed > 0){
+        fprintf(stderr, "%s: WARNING: %zu line%s improperly formatted\n", argv[0], malformed, malformed == 1 ? " is" : "s are");
+    }
+    if(check_mode && unreadable > 0){
+        fprintf(stderr, "%s: WARNING: %zu listed file%s could not be read\n", argv[0], unreadable, unreadable == 1 ? "" : "s");
+    }
+    if(mismatched > 0){
+        fprintf(stderr, "%s: WARNING: %zu computed checksum%s did NOT match\n", argv[0], mismatched, mismatched == 1 ? "" : "s");
+    }
+    if(unreadable > 0 || mismatched > 0){
+        result = -1;
+    }
 
-    free_easy(primes, K, NULL);
-    freeBuf(buf);
+    for(size_t i = 0; i < operand_count; ++i){
+        if(manifests[i] != NULL){
+            freeBuf(manifests[i]);
+        }
+    }
+    free(manifests);
+    cache_close(options.cache);
+    free(order);
+    free(list.jobs);
+    free(operands);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-    return EXIT_SUCCESS;
+// appends a job to the list, doubling it when needed
+hash_job *job_add(job_list *list, const char *arg){
+    if(list->count >= list->capacity){
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->jobs = realloc(list->jobs, list->capacity * sizeof(hash_job));
+        if(list->jobs == NULL){
+            perror("REALLOC FAILED IN FUNCTION job_add");
+            exit(1);
+        }
+    }
+    hash_job *job = &list->jobs[list->count++];
+    memset(job, 0, sizeof(*job));
+    job->arg = arg;
+    return job;
 }
 
+// reads "<hex>  <path>" lines, the format printed by the normal mode (and sha256sum),
+// the paths are cut in place on the lines of the manifest buffer
+int load_manifest(const char *manifest, size_t size, job_list *list, buf_t **buf, size_t *malformed){
+    struct stat st;
+    if(strcmp(manifest, "-") == 0){
+        // a manifest coming from a pipe, read to the end before anything is hashed
+        *buf = buf_from_FILE(stdin);
+        if(*buf == NULL){
+            return -1;
+        }
+    }else if(stat(manifest, &st) != 0){
+        fprintf(stderr, "%s: %s\n", manifest, strerror(errno));
+        return -1;
+    }else if(S_ISDIR(st.st_mode)){
+        fprintf(stderr, "%s: Is a directory\n", manifest);
+        return -1;
+    }else if(!S_ISREG(st.st_mode)){
+        // a fifo like <(sha256sum f), or a device, read to the end like stdin
+        FILE *file = fopen(manifest, "rb");
+        if(file == NULL){
+            fprintf(stderr, "%s: %s\n", manifest, strerror(errno));
+            return -1;
+        }
+        *buf = buf_from_FILE(file);
+        fclose(file);
+        if(*buf == NULL){
+            return -1;
+        }
+    }else{
+        // one allocation for the hole manifest, the lines are cut in place on it
+        *buf = initBuf(manifest);
+        if(loadFile(*buf) != 0){
+            return -1;
+        }
+    }
 
-// this function, frees each pointer until it finds a NULL argument
-void free_easy(void *first, ...) {
-    va_list args;
-    va_start(args, first);
+    size_t line_count = returnLines(*buf);
+    size_t first_job = list->count, first_malformed = *malformed;
+    for(size_t i = 0; i < line_count; ++i){
+        char *line = (*buf)->lines[i].content;
+        size_t len = (*buf)->lines[i].line_size;
+        // taking the line break out
+        while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')){
+            line[--len] = '\0';
+        }
+        if(len == 0){
+            continue;
+        }
 
-    void *ptr = first;
-    while(ptr != NULL){
-        free(ptr);
-        ptr = va_arg(args, void *);
+        uint8_t expected[SHA512_DIGEST_SIZE];
+        bool valid = len > 2 * size + 2;
+        for(size_t b = 0; valid && b < size; ++b){
+            char pair[3] = { line[b * 2], line[b * 2 + 1], '\0' };
+            valid = isxdigit((unsigned char)pair[0]) && isxdigit((unsigned char)pair[1]);
+            expected[b] = (uint8_t)strtoul(pair, NULL, 16);
+        }
+        // two spaces for text, space and '*' for binary
+        char *separator = &line[2 * size];
+        if(!valid || separator[0] != ' ' || (separator[1] != ' ' && separator[1] != '*')){
+            (*malformed)++;
+            continue;
+        }
+
+        hash_job *job = job_add(list, &separator[2]);
+        job->check = true;
+        memcpy(job->expected, expected, size);
+        if(stat(job->arg, &st) == 0){
+            job->size = st.st_size;
+        }
     }
-    va_end(args);
+    // like sha256sum, a manifest without a single valid line is an error of its own, not a warning
+    if(list->count == first_job){
+        fprintf(stderr, "%s: no properly formatted checksum lines found\n", manifest);
+        *malformed = first_malformed;
+        return -1;
+    }
+    return 0;
 }
 
-// returns an array of all the first 64 prime numbers 
-uint32_t *prime_arr_generator(){
-    int limit = 311;
-    int is_prime[limit + 1];
+// the job indexes sorted from the biggest file to the smallest
+static const hash_job *sort_jobs;
+static int compare_size(const void *a, const void *b){
+    uint64_t size_a = sort_jobs[*(const size_t *)a].size;
+    uint64_t size_b = sort_jobs[*(const size_t *)b].size;
+    if(size_a != size_b){
+        return size_a > size_b ? -1 : 1;
+    }
+    // same size keeps the manifest order
+    return *(const size_t *)a < *(const size_t *)b ? -1 : 1;
+}
 
-    for(int i = 0; i <= limit; i++){
-        is_prime[i] = 1;
+size_t *largest_first(hash_job *jobs, size_t count){
+    size_t *order = malloc(sizeof(size_t) * (count ? count : 1));
+    if(order == NULL){
+        perror("malloc failed, in function largest_first");
+        exit(1);
+    }
+    for(size_t i = 0; i < count; ++i){
+        order[i] = i;
     }
-    
-    is_prime[0] = is_prime[1] = 0;
+    sort_jobs = jobs;
+    qsort(order, count, sizeof(size_t), compare_size);
+    return order;
+}
 
-    for(int i = 2; i * i <= limit; i++){
-        if(is_prime[i]){
-            for(int j = i * i; j <= limit; j += i){
-                is_prime[j] = 0;
-            }
+void print_usage(const char *name){
+    fprintf(stderr, "USAGE: %s [-a ALGORITHM] [-j N] [--mmap | --io-uring] [--cache FILE] <filename or string>...\n", name);
+    fprintf(stderr, "       %s [-a ALGORITHM] < stream, - is stdin in the normal, -c, --hmac, --merkle, --cdc and\n", name);
+    fprintf(stderr, "       --client modes\n");
+    fprintf(stderr, "       %s [-a ALGORITHM] [-j N] [--mmap | --io-uring] [--cache FILE] -c <manifest>...\n", name);
+    fprintf(stderr, "       %s [-j N] [--mmap] [--cache FILE] -r [--summary] <directory or filename>...\n", name);
+    fprintf(stderr, "       %s [-j N] [--cache FILE] [-c | -r] --checkpoint[=INTERVAL] [--resume] <filename>...\n", name);
+    fprintf(stderr, "       %s [-j N] --tree[=CHUNK] <filename>...\n", name);
+    fprintf(stderr, "       %s [-j N] --merkle [--record-size N] [--proof LEAF]... <filename or ->...\n", name);
+    fprintf(stderr, "       %s [-j N] --cdc <filename or ->...\n", name);
+    fprintf(stderr, "       %s [-j N] --daemon SOCKET\n", name);
+    fprintf(stderr, "       %s --client SOCKET [--send-fd] <filename or string>...\n", name);
+    fprintf(stderr, "       %s --hmac KEY <filename or string>...\n", name);
+    fprintf(stderr, "       %s [-j N] --pbkdf2 SALT ITERATIONS [--dklen N] <password>...\n", name);
+    fprintf(stderr, "       %s --self-test\n", name);
+    fprintf(stderr, "any mode takes --stats[=text|json], a report of the run on stderr\n");
+    fprintf(stderr, "ALGORITHM: sha256 (default), sha512, sha384 or sha512-256\n");
+}
+
+// reads a size like 4096, 64K, 1M or 2G
+int parse_size(const char *value, size_t *size){
+    char *end = NULL;
+    unsigned long long number = strtoull(value, &end, 10);
+    if(end == value){
+        return -1;
+    }
+    switch(toupper((unsigned char)*end)){
+        case 'K': number <<= 10; end++; break;
+        case 'M': number <<= 20; end++; break;
+        case 'G': number <<= 30; end++; break;
+    }
+    if(*end != '\0'){
+        return -1;
+    }
+    *size = (size_t)number;
+    return 0;
+}
+
+// --tree, the output is labeled so it can't be mistaken for (or checked as) a plain SHA-256
+int tree_main(const char *const *paths, size_t count, size_t chunk, int workers){
+    int failed = 0;
+    for(size_t i = 0; i < count; ++i){
+        uint8_t root[SHA256_DIGEST_SIZE];
+        if(tree_hash_file(paths[i], chunk, workers, root) != 0){
+            failed = 1;
+            continue;
         }
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        sha256_hex(root, hex);
+        printf("TREE-SHA256-%zu (%s) = %s\n", chunk, paths[i], hex);
     }
+    return failed;
+}
 
-    uint32_t *primes = malloc(sizeof(uint32_t) * NUM_OF_PRIMES);
-    if(primes == NULL){
-        perror("malloc failed, in function prime_arr_generator");
-        exit(1);
-        return NULL;
+// --merkle, the root of each file, then the path of every leaf asked for with --proof, from the leaf up
+int merkle_main(const char *const *paths, size_t count, size_t record_size, const size_t *proofs, size_t nproofs,
+                int workers){
+    merkle_proof *found = calloc(nproofs ? nproofs : 1, sizeof(merkle_proof));
+    if(found == NULL){
+        perror("calloc failed, in function merkle_main");
+        return 1;
     }
+    int failed = 0;
+    for(size_t i = 0; i < count; ++i){
+        for(size_t p = 0; p < nproofs; ++p){
+            found[p].index = proofs[p];
+        }
+        uint8_t root[SHA256_DIGEST_SIZE];
+        size_t leaves = 0;
+        int status;
+        if(strcmp(paths[i], "-") == 0){
+            status = merkle_root_stream(stdin, record_size, workers, found, nproofs, root, &leaves);
+        }else if(record_size > 0){
+            status = merkle_root_records(paths[i], record_size, workers, found, nproofs, root, &leaves);
+        }else{
+            buf_t *buf = initBuf(paths[i]);
+            status = loadFile(buf) != 0 ? -1 : merkle_root_lines(buf, workers, found, nproofs, root, &leaves);
+            freeBuf(buf);
+        }
+        if(status != 0){
+            fprintf(stderr, "%s: no Merkle root\n", paths[i]);
+            failed = 1;
+            continue;
+        }
 
-    int count = 0;
-    for(int i = 2; i <= limit && count < NUM_OF_PRIMES; i++){
-        if(is_prime[i]){
-            primes[count++] = i;
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        sha256_hex(root, hex);
+        printf("MERKLE-SHA256 (%s) = %s\n", paths[i], hex);
+        for(size_t p = 0; p < nproofs; ++p){
+            sha256_hex(found[p].leaf, hex);
+            printf("PROOF %zu/%zu (%s) = %s", found[p].index, leaves, paths[i], hex);
+            for(size_t s = 0; s < found[p].steps; ++s){
+                sha256_hex(found[p].siblings[s], hex);
+                printf(" %c:%s", found[p].sides[s], hex);
+            }
+            printf("\n");
         }
     }
+    free(found);
+    return failed;
+}
 
-    return primes;
+// --cdc, an "offset length digest" line per chunk, with several files each one starts with a "# path" line
+int cdc_main(const char *const *paths, size_t count, int workers){
+    cdc_params params;
+    cdc_default_params(&params);
+    int failed = 0;
+    for(size_t i = 0; i < count; ++i){
+        cdc_chunk *chunks = NULL;
+        size_t found = 0;
+        int status = strcmp(paths[i], "-") == 0 ? cdc_hash_fd(STDIN_FILENO, &params, &chunks, &found)
+                                                : cdc_hash_file(paths[i], &params, workers, &chunks, &found);
+        if(status != 0){
+            if(strcmp(paths[i], "-") == 0){
+                fprintf(stderr, "-: read error\n");
+            }
+            failed = 1;
+            continue;
+        }
+        stats_mark mark = stats_begin();
+        if(count > 1){
+            printf("# %s\n", paths[i]);
+        }
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        for(size_t c = 0; c < found; ++c){
+            sha256_hex(chunks[c].digest, hex);
+            printf("%llu %u %s\n", (unsigned long long)chunks[c].offset, (unsigned)chunks[c].length, hex);
+        }
+        stats_end(STATS_OUTPUT, mark);
+        free(chunks);
+    }
+    return failed;
 }
 
-static inline uint32_t sigma0(uint32_t x){
-    return right_rotate_asm(x, 7) ^ right_rotate_asm(x, 18) ^ (x >> 3);
+// -r, every regular file under the directories, sorted by path, --summary adds one digest for the hole tree
+int recursive_main(const char *const *paths, size_t count, int workers, const hash_options *options, bool summary){
+    int failed = 0;
+    for(size_t i = 0; i < count; ++i){
+        struct stat st;
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+
+        // a plain file is hashed the usual way
+        if(stat(paths[i], &st) == 0 && !S_ISDIR(st.st_mode)){
+            if(hash_argument(paths[i], options, digest) != 0){
+                failed = 1;
+                continue;
+            }
+            sha256_hex(digest, hex);
+            printf("%s  %s\n", hex, paths[i]);
+            continue;
+        }
+
+        walk_entry *entries = NULL;
+        size_t found = 0;
+        if(walk_hash_tree(paths[i], workers, walk_hash, (void *)options, &entries, &found) != 0){
+            failed = 1;
+        }
+        for(size_t e = 0; e < found; ++e){
+            if(entries[e].status == 0){
+                sha256_hex(entries[e].digest, hex);
+                printf("%s  %s\n", hex, entries[e].path);
+            }
+        }
+        if(summary){
+            walk_tree_digest(paths[i], entries, found, digest);
+            sha256_hex(digest, hex);
+            printf("TREE-LISTING-SHA256 (%s) = %s\n", paths[i], hex);
+        }
+        walk_free(entries, found);
+    }
+    return failed;
 }
 
-static inline uint32_t sigma1(uint32_t x){
-    return right_rotate_asm(x, 17) ^ right_rotate_asm(x, 19) ^ (x >> 10);
+// --hmac, files are streamed and anything else is the message itself, like the normal mode
+int hmac_main(const char *const *args, size_t count, const char *key){
+    int failed = 0;
+    hmac_sha256_key hkey;
+    hmac_sha256_set_key(&hkey, key, strlen(key));
+    for(size_t i = 0; i < count; ++i){
+        struct stat st;
+        uint8_t mac[SHA256_DIGEST_SIZE];
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        if(strcmp(args[i], "-") == 0){
+            // stdin, streamed into the inner hash like the normal mode does
+            if(hmac_stream(STDIN_FILENO, &hkey, mac) != 0){
+                fprintf(stderr, "-: read error\n");
+                failed = 1;
+                continue;
+            }
+        }else if(stat(args[i], &st) == 0 && S_ISREG(st.st_mode)){
+            if(hmac_sha256_file(&hkey, args[i], mac) != 0){
+                failed = 1;
+                continue;
+            }
+        }else{
+            hmac_sha256_keyed(&hkey, args[i], strlen(args[i]), mac);
+        }
+        sha256_hex(mac, hex);
+        printf("HMAC-SHA256 (%s) = %s\n", args[i], hex);
+    }
+    return failed;
 }
 
-// Expand message schedule
-void process(uint8_t *processed_data, uint32_t *w){
-    // Load the first 16 words
-    for(int i = 0; i < 16; ++i){
-        int j = i * 4;
-        w[i] = (processed_data[j] << 24) | (processed_data[j+1] << 16) | (processed_data[j+2] << 8) | processed_data[j+3];
+// --pbkdf2, one derived key per password, the password isn't printed back
+int pbkdf2_main(const char *const *passwords, size_t count, const char *salt, uint32_t iterations, size_t length, int workers){
+    uint8_t *derived = malloc(length);
+    char *hex = malloc(2 * length + 1);
+    if(derived == NULL || hex == NULL){
+        perror("malloc failed, in function pbkdf2_main");
+        exit(1);
     }
+    int failed = 0;
+    for(size_t i = 0; i < count; ++i){
+        if(pbkdf2_hmac_sha256(passwords[i], strlen(passwords[i]), salt, strlen(salt), iterations, derived, length, workers) != 0){
+            failed = 1;
+            continue;
+        }
+        digest_hex(derived, length, hex);
+        printf("%s\n", hex);
+    }
+    free(hex);
+    free(derived);
+    return failed;
+}
 
-    // Expand words 16..63
-    for(int i = 16; i < 64; ++i){
-        w[i] = sigma1(w[i-2]) + w[i-7] + sigma0(w[i-15]) + w[i-16];
+// the walk hashes the files the same way as the normal mode
+int walk_hash(const char *path, uint8_t digest[SHA256_DIGEST_SIZE], void *ctx){
+    return hash_path(path, ctx, digest);
+}
+
+// runs on the workers, hashes one argument
+void hash_task(size_t index, void *ctx){
+    hash_run *run = ctx;
+    hash_job *job = &run->jobs[index];
+    if(job->check){
+        job->status = hash_path(job->arg, run->options, job->digest);
+        job->matched = job->status == 0 && memcmp(job->digest, job->expected, digest_size(run->options)) == 0;
+    }else{
+        job->status = hash_argument(job->arg, run->options, job->digest);
     }
+    job_finished(run, job);
 }
 
-// compression loop
-void compress(uint32_t *w, uint32_t *hash, const uint32_t *K){
-    // getting my initial values
-    uint32_t a = hash[0];
-    uint32_t b = hash[1];
-    uint32_t c = hash[2];
-    uint32_t d = hash[3];
-    uint32_t e = hash[4];
-    uint32_t f = hash[5];
-    uint32_t g = hash[6];
-    uint32_t h = hash[7];
-
-    // doing the compression
-    for(int i = 0; i < 64; ++i){
-        uint32_t S1 = right_rotate_asm(e,6) ^ right_rotate_asm(e,11) ^ right_rotate_asm(e,25);
-        uint32_t ch = (e & f) ^ ((~e) & g);
-        uint32_t temp1 = h + S1 + ch + K[i] + w[i];
-
-        uint32_t S0 = right_rotate_asm(a,2) ^ right_rotate_asm(a,13) ^ right_rotate_asm(a,22);
-        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
-        uint32_t temp2 = S0 + maj;
-
-        h = g;
-        g = f;
-        f = e;
-        e = d + temp1;
-        d = c;
-        c = b;
-        b = a;
-        a = temp1 + temp2;
-    }
-
-    hash[0] += a;
-    hash[1] += b;
-    hash[2] += c;
-    hash[3] += d;
-    hash[4] += e;
-    hash[5] += f;
-    hash[6] += g;
-    hash[7] += h;
+// marks the job as done, and prints every result that is ready, in the argument order
+void job_finished(hash_run *run, hash_job *job){
+    pthread_mutex_lock(&run->print_lock);
+    stats_mark mark = stats_begin();
+    job->done = true;
+    while(run->next_print < run->count && run->jobs[run->next_print].done){
+        hash_job *ready = &run->jobs[run->next_print++];
+        if(ready->check){
+            printf("%s: %s\n", ready->arg, ready->status != 0 ? "FAILED open or read" : (ready->matched ? "OK" : "FAILED"));
+        }else if(ready->status == 0){
+            char hex[2 * SHA512_DIGEST_SIZE + 1];
+            digest_hex(ready->digest, digest_size(run->options), hex);
+            printf("%s  %s\n", hex, ready->arg);
+        }
+    }
+    stats_end(STATS_OUTPUT, mark);
+    pthread_mutex_unlock(&run->print_lock);
 }
 
-// function to pad the file
-uint8_t* padding(buf_t* buf){
-    // K is the amount of 0x00 that I will have to put on the padded data
-    ssize_t K = buf->file_size;
-    // this is used to store the CURRENT size of the file, important because it need's to be added at the
-    // last 8 bytes
-    uint64_t length = buf->file_size;
-    // this ensures that K is leaves "space", for the size of the file
-    while(K % 64 != 56){
-        K++;
-    }
-    // I realloc lines[0].content, so I can hold the bytes that have 0x00 and the size
-    buf->lines[0].content = realloc(buf->lines[0].content, K + 8);
-    // simple checking
-    if(buf->lines[0].content == NULL){
-        perror("REALOC Failed, in function padding");
+// with --io-uring, worker takes every run->workers-th job, strings are hashed right away and the files
+// go all to the worker's ring
+void uring_task(size_t worker, void *ctx){
+    hash_run *run = ctx;
+    size_t most = run->count / run->workers + 1;
+    const char **paths = calloc(most, sizeof(char *));
+    size_t *positions = malloc(sizeof(size_t) * most);
+    if(paths == NULL || positions == NULL){
+        perror("malloc failed, in function uring_task");
         exit(1);
-        return NULL;
-    }
-    // appending 0x80 at the right next available space
-    buf->lines->content[buf->file_size++] = BIT_1;
-    // appending K 0x00
-    for(int i = buf->file_size; i < K; ++i){
-        buf->lines->content[i] = BIT_0;
-    }
-    // this holds the length, in bytes
-    uint64_t bit_len = length * 8;
-    for (int i = 7; i >= 0; --i){
-        // getting in the inverse, because it needs to be in small endian, the shifiting then data to it's
-        // direct opposite position, then ensuring that I get only 8 bits per time
-        buf->lines[0].content[K + (7 - i)] = (bit_len >> (i * 8)) & 0xFF;
-    }
-    // updating
-    buf->file_size = K + 8;
-    buf->lines[0].line_size = K + 8;
-    // returning
-    return (uint8_t*)buf->lines[0].content;
+    }
+
+    size_t files = 0;
+    for(size_t i = worker; i < run->count; i += run->workers){
+        size_t index = run->order ? run->order[i] : i;
+        hash_job *job = &run->jobs[index];
+        struct stat st;
+        // stdin is streamed by hash_task()
+        bool is_stdin = strcmp(job->arg, "-") == 0;
+        if(!is_stdin && (job->check || (stat(job->arg, &st) == 0 && S_ISREG(st.st_mode)))){
+            // the files on the cache don't need the ring
+            if(run->options->cache != NULL){
+                int found = cache_find(run->options->cache, job->arg, &job->key, job->digest);
+                job->has_key = found >= 0;
+                if(found == 1){
+                    job->status = 0;
+                    job->matched = memcmp(job->digest, job->expected, SHA256_DIGEST_SIZE) == 0;
+                    job_finished(run, job);
+                    continue;
+                }
+            }
+            paths[files] = job->arg;
+            positions[files++] = index;
+        }else{
+            hash_task(index, run);
+        }
+    }
+
+    uring_batch batch = { run, positions };
+    if(uring_hash_files(paths, files, URING_DEPTH, uring_job_done, &batch) != 0){
+        // the ring couldn't be made for this worker, the files are read normally
+        for(size_t i = 0; i < files; ++i){
+            hash_task(positions[i], run);
+        }
+    }
+    free(paths);
+    free(positions);
 }
 
-// Initialize array of round constants
-uint32_t *initialize_array_of_constants(uint32_t *primes){
-    if(primes == NULL){
-        perror("the argument was NULL, in function initialize_array_of_conastants");
-        exit(1);
-        return NULL;
+// the ring finished a file
+void uring_job_done(size_t index, int status, const uint8_t digest[SHA256_DIGEST_SIZE], void *ctx){
+    uring_batch *batch = ctx;
+    hash_job *job = &batch->run->jobs[batch->positions[index]];
+    job->status = status;
+    if(status == 0){
+        memcpy(job->digest, digest, SHA256_DIGEST_SIZE);
+        job->matched = memcmp(job->digest, job->expected, SHA256_DIGEST_SIZE) == 0;
+        if(job->has_key){
+            cache_remember(batch->run->options->cache, job->arg, &job->key, digest);
+        }
     }
+    job_finished(batch->run, job);
+}
 
-    // each constant takes 32 bits
-    uint32_t *array_of_constants = malloc(sizeof(uint32_t) * NUM_OF_PRIMES);
-    if(array_of_constants == NULL){
-        exit(1);
-        return NULL;
+// a file gets its contents hashed, anything else is treated as a string
+int hash_argument(const char *arg, const hash_options *options, uint8_t *digest){
+    if(strcmp(arg, "-") == 0){
+        return hash_stdin(options, digest);
+    }
+    // Try to open as a file first
+    struct stat st;
+    bool exists = stat(arg, &st) == 0;
+    if(exists && S_ISREG(st.st_mode)){
+        // Is a real file
+        return hash_path(arg, options, digest);
+    }
+    // hashing the name of a directory is never what was wanted
+    if(exists && S_ISDIR(st.st_mode)){
+        fprintf(stderr, "%s: Is a directory (use -r)\n", arg);
+        return -1;
     }
+    // Not a file → treat as string
+    size_t len = strlen(arg);
+    stats_mark mark = stats_begin();
+    if(options->use_sha512){
+        sha512(options->variant, arg, len, digest);
+        stats_message(len, stats_sha512_blocks(len));
+    }else{
+        sha256(arg, len, digest);
+        stats_message(len, stats_sha256_blocks(len));
+    }
+    stats_end(STATS_HASH, mark);
+    return 0;
+}
 
-    // we only take the fractional part of the cubic root of the constant
-    for(int i = 0; i < NUM_OF_PRIMES; ++i) {
-        // base = cubic root of the prime
-        double base = cbrt((double) primes[i]);
-        // base minus it's own fractional part
-        double fractional_part = base - floor(base);
-        // meking it equal
-        array_of_constants[i] = (uint32_t)(floor(fractional_part * (1ULL << 32)));
+// hashes a file, or takes its digest from the cache when it didn't change since it was saved there
+int hash_path(const char *path, const hash_options *options, uint8_t *digest){
+    // a "-" on a manifest is stdin too, and a stream can't be on the cache
+    if(strcmp(path, "-") == 0){
+        return hash_stdin(options, digest);
+    }
+    if(options->cache == NULL){
+        return hash_contents(path, options, digest);
+    }
+    cache_key key;
+    int found = cache_find(options->cache, path, &key, digest);
+    if(found == 1){
+        return 0;
     }
+    int status = hash_contents(path, options, digest);
+    if(status == 0 && found == 0){
+        cache_remember(options->cache, path, &key, digest);
+    }
+    return status;
+}
+
+// reads the file, with the reading the options ask for
+int hash_contents(const char *path, const hash_options *options, uint8_t *digest){
+    if(options->checkpoint_interval > 0){
+        return checkpoint_hash_file(path, options->checkpoint_interval, options->resume, digest);
+    }
+    if(options->use_sha512){
+        return options->use_mmap ? hash_file_sha512_mapped(path, options->variant, digest)
+                                 : hash_file_sha512(path, options->variant, digest);
+    }
+    return options->use_mmap ? hash_file_mapped(path, digest) : hash_file(path, digest);
+}
+
+// "-", stdin read by another thread while it's hashed, so a pipe never has to go through a file first
+int hash_stdin(const hash_options *options, uint8_t *digest){
+    int status = options->use_sha512 ? hash_stream_sha512(STDIN_FILENO, options->variant, digest)
+                                     : hash_stream(STDIN_FILENO, digest);
+    if(status != 0){
+        fprintf(stderr, "-: read error\n");
+    }
+    return status;
+}
+
+// bytes of the digests of the algorithm picked with -a
+size_t digest_size(const hash_options *options){
+    return options->use_sha512 ? sha512_digest_size(options->variant) : SHA256_DIGEST_SIZE;
+}
 
-    return array_of_constants;
+// like sha256_hex(), for any digest size, out needs 2 * size + 1 bytes
+void digest_hex(const uint8_t *digest, size_t size, char *out){
+    for(size_t i = 0; i < size; ++i){
+        sprintf(&out[i * 2], "%02x", digest[i]);
+    }
+    out[size * 2] = '\0';
+}
+
+// the stat() gives the key, 1 on a hit, 0 on a miss, -1 if the file can't be on the cache
+int cache_find(digest_cache *cache, const char *path, cache_key *key, uint8_t digest[SHA256_DIGEST_SIZE]){
+    struct stat st;
+    if(stat(path, &st) != 0 || !S_ISREG(st.st_mode)){
+        return -1;
+    }
+    cache_key_from_stat(&st, key);
+    return cache_lookup(cache, key, digest);
+}
+
+// only saves the digest if the file still is the one that started being hashed, a file that was
+// being written while it was read could have a digest of neither version
+void cache_remember(digest_cache *cache, const char *path, const cache_key *key, const uint8_t digest[SHA256_DIGEST_SIZE]){
+    struct stat st;
+    cache_key after;
+    if(stat(path, &st) != 0){
+        return;
+    }
+    cache_key_from_stat(&st, &after);
+    if(memcmp(&after, key, sizeof(after)) == 0){
+        cache_store(cache, key, digest);
+    }
 }
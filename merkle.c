@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "merkle.h"
+#include "tree.h"
+#include "batch.h"
+#include "pool.h"
+#include "stats.h"
+
+/*
+ * File Description : Merkle roots over many small leaves, each window of leaves is a pool task that hashes
+ * all of its leaves in one batch and then every level of its subtree in one batch per level, the window
+ * roots are reduced the same way at the end
+*/
+
+// what the window tasks share
+typedef struct Merkle_job {
+    // leaves in memory
+    const uint8_t *const *leaves;
+    const size_t *lens;
+    // or records of a file, when fd >= 0
+    int fd;
+    uint64_t size;
+    size_t record_size;
+    size_t count;
+    // leaves per window, a power of two
+    size_t window;
+    uint8_t (*window_roots)[SHA256_DIGEST_SIZE];
+    merkle_proof *proofs;
+    size_t nproofs;
+    // set by any worker that fails
+    int failed;
+} merkle_job;
+
+// reduces count digests to levels[0], level by level, pos[i] is where proofs[i] is on the current level
+static void merkle_reduce(uint8_t (*levels)[SHA256_DIGEST_SIZE], size_t count, merkle_proof **proofs, size_t *pos,
+                          size_t nproofs){
+    size_t pairs_max = count / 2 + 1;
+    uint8_t (*nodes)[1 + 2 * SHA256_DIGEST_SIZE] = malloc(pairs_max * sizeof(*nodes));
+    const uint8_t **msgs = malloc(pairs_max * sizeof(uint8_t *));
+    size_t *lens = malloc(pairs_max * sizeof(size_t));
+    if(nodes == NULL || msgs == NULL || lens == NULL){
+        perror("malloc failed, in function merkle_reduce");
+        exit(1);
+    }
+
+    while(count > 1){
+        // the siblings are taken before the level is overwritten by the next one
+        for(size_t p = 0; p < nproofs; ++p){
+            size_t sibling = pos[p] ^ 1;
+            if(sibling < count){
+                merkle_proof *proof = proofs[p];
+                memcpy(proof->siblings[proof->steps], levels[sibling], SHA256_DIGEST_SIZE);
+                proof->sides[proof->steps++] = pos[p] & 1 ? 'L' : 'R';
+            }
+            pos[p] >>= 1;
+        }
+
+        size_t pairs = count / 2;
+        for(size_t i = 0; i < pairs; ++i){
+            nodes[i][0] = TREE_NODE_PREFIX;
+            memcpy(&nodes[i][1], levels[2 * i], SHA256_DIGEST_SIZE);
+            memcpy(&nodes[i][1 + SHA256_DIGEST_SIZE], levels[2 * i + 1], SHA256_DIGEST_SIZE);
+            msgs[i] = nodes[i];
+            lens[i] = sizeof(nodes[i]);
+        }
+        stats_mark mark = stats_begin();
+        if(sha256_batch_workers(msgs, lens, pairs, levels, 1) != 0){
+            exit(1);
+        }
+        stats_end(STATS_HASH, mark);
+        stats_message(pairs * sizeof(nodes[0]), pairs * stats_sha256_blocks(sizeof(nodes[0])));
+        // the one without a pair goes up as it is
+        if(count % 2 == 1){
+            memcpy(levels[pairs], levels[count - 1], SHA256_DIGEST_SIZE);
+        }
+        count = pairs + count % 2;
+    }
+
+    free(nodes);
+    free(msgs);
+    free(lens);
+}
+
+// 0x00 || record for every record of the window, read into staging one after the other, -1 if the read failed
+static int merkle_stage_records(merkle_job *job, size_t first, size_t count, uint8_t *staging, const uint8_t **msgs,
+                                size_t *lens){
+    uint64_t offset = (uint64_t)first * job->record_size;
+    size_t len = job->size - offset < (uint64_t)count * job->record_size ? (size_t)(job->size - offset)
+                                                                          : count * job->record_size;
+    // read packed at the end of staging, then spread from the front, a record never lands past where the
+    // next one still has to be read from
+    uint8_t *packed = staging + count;
+    size_t done = 0;
+    while(done < len){
+        stats_mark mark = stats_begin();
+        ssize_t got = pread(job->fd, packed + done, len - done, (off_t)(offset + done));
+        stats_end(STATS_READ, mark);
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got <= 0){
+            perror("pread failed, in function merkle_stage_records");
+            return -1;
+        }
+        done += (size_t)got;
+    }
+    for(size_t i = 0; i < count; ++i){
+        // only the last record of the file can be shorter
+        size_t record = len - i * job->record_size < job->record_size ? len - i * job->record_size
+                                                                       : job->record_size;
+        uint8_t *leaf = &staging[i * (job->record_size + 1)];
+        memmove(leaf + 1, &packed[i * job->record_size], record);
+        leaf[0] = TREE_LEAF_PREFIX;
+        msgs[i] = leaf;
+        lens[i] = record + 1;
+    }
+    return 0;
+}
+
+// 0x00 || leaf for every leaf of the window, one after the other
+static void merkle_stage_leaves(merkle_job *job, size_t first, size_t count, uint8_t *staging, const uint8_t **msgs,
+                                size_t *lens){
+    size_t at = 0;
+    for(size_t i = 0; i < count; ++i){
+        staging[at] = TREE_LEAF_PREFIX;
+        memcpy(&staging[at + 1], job->leaves[first + i], job->lens[first + i]);
+        msgs[i] = &staging[at];
+        lens[i] = job->lens[first + i] + 1;
+        at += lens[i];
+    }
+}
+
+// hashes the leaves of one window and reduces them to its root
+static void merkle_window_task(size_t index, void *ctx){
+    merkle_job *job = ctx;
+    size_t first = index * job->window;
+    size_t count = job->count - first < job->window ? job->count - first : job->window;
+
+    size_t staging_size = 0;
+    if(job->fd >= 0){
+        staging_size = count * (job->record_size + 1);
+    }else{
+        for(size_t i = 0; i < count; ++i){
+            staging_size += job->lens[first + i] + 1;
+        }
+    }
+    uint8_t *staging = malloc(staging_size);
+    const uint8_t **msgs = malloc(count * sizeof(uint8_t *));
+    size_t *lens = malloc(count * sizeof(size_t));
+    uint8_t (*digests)[SHA256_DIGEST_SIZE] = malloc(count * SHA256_DIGEST_SIZE);
+    merkle_proof **proofs = malloc((job->nproofs ? job->nproofs : 1) * sizeof(merkle_proof *));
+    size_t *pos = malloc((job->nproofs ? job->nproofs : 1) * sizeof(size_t));
+    if(staging == NULL || msgs == NULL || lens == NULL || digests == NULL || proofs == NULL || pos == NULL){
+        perror("malloc failed, in function merkle_window_task");
+        exit(1);
+    }
+
+    if(job->fd < 0){
+        merkle_stage_leaves(job, first, count, staging, msgs, lens);
+    }else if(merkle_stage_records(job, first, count, staging, msgs, lens) != 0){
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+    }
+
+    if(!__atomic_load_n(&job->failed, __ATOMIC_RELAXED)){
+        stats_mark mark = stats_begin();
+        if(sha256_batch_workers(msgs, lens, count, digests, 1) != 0){
+            __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        }
+        stats_end(STATS_HASH, mark);
+    }
+    if(!__atomic_load_n(&job->failed, __ATOMIC_RELAXED)){
+        for(size_t i = 0; i < count; ++i){
+            stats_message(lens[i], stats_sha256_blocks(lens[i]));
+        }
+
+        size_t found = 0;
+        for(size_t p = 0; p < job->nproofs; ++p){
+            if(job->proofs[p].index >= first && job->proofs[p].index < first + count){
+                memcpy(job->proofs[p].leaf, digests[job->proofs[p].index - first], SHA256_DIGEST_SIZE);
+                proofs[found] = &job->proofs[p];
+                pos[found++] = job->proofs[p].index - first;
+            }
+        }
+        merkle_reduce(digests, count, proofs, pos, found);
+        memcpy(job->window_roots[index], digests[0], SHA256_DIGEST_SIZE);
+    }
+
+    free(staging);
+    free(msgs);
+    free(lens);
+    free(digests);
+    free(proofs);
+    free(pos);
+}
+
+// the windows on the pool, then the window roots, job->count and job->window are already set
+static int merkle_build(merkle_job *job, int workers, uint8_t root[SHA256_DIGEST_SIZE]){
+    for(size_t p = 0; p < job->nproofs; ++p){
+        if(job->proofs[p].index >= job->count){
+            fprintf(stderr, "merkle: leaf %zu doesn't exist, there are %zu leaves\n", job->proofs[p].index,
+                    job->count);
+            return -1;
+        }
+        job->proofs[p].steps = 0;
+    }
+    size_t windows = (job->count + job->window - 1) / job->window;
+    job->window_roots = malloc(windows * SHA256_DIGEST_SIZE);
+    merkle_proof **proofs = malloc((job->nproofs ? job->nproofs : 1) * sizeof(merkle_proof *));
+    size_t *pos = malloc((job->nproofs ? job->nproofs : 1) * sizeof(size_t));
+    if(job->window_roots == NULL || proofs == NULL || pos == NULL){
+        perror("malloc failed, in function merkle_build");
+        exit(1);
+    }
+
+    if(workers <= 1 || windows == 1){
+        for(size_t w = 0; w < windows; ++w){
+            merkle_window_task(w, job);
+        }
+    }else if(pool_run(workers < (int)windows ? workers : (int)windows, windows, NULL, merkle_window_task, job) != 0){
+        job->failed = 1;
+    }
+
+    if(!job->failed){
+        // a window is a whole subtree, so a leaf is at index / window on the level of the window roots
+        for(size_t p = 0; p < job->nproofs; ++p){
+            proofs[p] = &job->proofs[p];
+            pos[p] = job->proofs[p].index / job->window;
+        }
+        merkle_reduce(job->window_roots, windows, proofs, pos, job->nproofs);
+        memcpy(root, job->window_roots[0], SHA256_DIGEST_SIZE);
+    }
+    free(job->window_roots);
+    free(proofs);
+    free(pos);
+    return job->failed ? -1 : 0;
+}
+
+// the biggest power of two up to MERKLE_WINDOW that still gives every worker a few windows
+static size_t merkle_window(size_t count, int workers){
+    size_t window = MERKLE_WINDOW;
+    while(window > MERKLE_WINDOW_MIN && (count + window - 1) / window < (size_t)workers * 4){
+        window /= 2;
+    }
+    return window;
+}
+
+int merkle_root(const uint8_t *const *leaves, const size_t *lens, size_t n, int workers, merkle_proof *proofs,
+                size_t nproofs, uint8_t root[SHA256_DIGEST_SIZE]){
+    if(n == 0){
+        fprintf(stderr, "merkle: there are no leaves\n");
+        return -1;
+    }
+    sha256_setup();
+    merkle_job job = { .leaves = leaves, .lens = lens, .fd = -1, .count = n, .proofs = proofs, .nproofs = nproofs };
+    job.window = merkle_window(n, workers);
+    return merkle_build(&job, workers, root);
+}
+
+int merkle_root_lines(buf_t *buf, int workers, merkle_proof *proofs, size_t nproofs,
+                      uint8_t root[SHA256_DIGEST_SIZE], size_t *count){
+    indexLines(buf);
+    size_t n = buf->line_count;
+    const uint8_t **leaves = malloc((n ? n : 1) * sizeof(uint8_t *));
+    size_t *lens = malloc((n ? n : 1) * sizeof(size_t));
+    if(leaves == NULL || lens == NULL){
+        perror("malloc failed, in function merkle_root_lines");
+        exit(1);
+    }
+    // the leaf is the line without its end
+    for(size_t i = 0; i < n; ++i){
+        size_t len = buf->lines[i].line_size;
+        if(len > 0 && buf->lines[i].content[len - 1] == '\n'){
+            len--;
+            if(len > 0 && buf->lines[i].content[len - 1] == '\r'){
+                len--;
+            }
+        }
+        leaves[i] = (const uint8_t *)buf->lines[i].content;
+        lens[i] = len;
+    }
+
+    int result = merkle_root(leaves, lens, n, workers, proofs, nproofs, root);
+    *count = n;
+    free(leaves);
+    free(lens);
+    return result;
+}
+
+int merkle_root_records(const char *path, size_t record_size, int workers, merkle_proof *proofs, size_t nproofs,
+                        uint8_t root[SHA256_DIGEST_SIZE], size_t *count){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        fprintf(stderr, "ERROR OPENING FILE %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        fprintf(stderr, "%s: the records only work on regular files\n", path);
+        close(fd);
+        return -1;
+    }
+    if(st.st_size == 0){
+        fprintf(stderr, "%s: there are no leaves\n", path);
+        close(fd);
+        return -1;
+    }
+    sha256_setup();
+
+    merkle_job job = { .fd = fd, .size = (uint64_t)st.st_size, .record_size = record_size, .proofs = proofs,
+                       .nproofs = nproofs };
+    job.count = (size_t)((job.size + record_size - 1) / record_size);
+    job.window = merkle_window(job.count, workers);
+    // a window is read at once
+    while(job.window > 1 && job.window * record_size > MERKLE_WINDOW_BYTES){
+        job.window /= 2;
+    }
+    *count = job.count;
+    int result = merkle_build(&job, workers, root);
+    close(fd);
+    return result;
+}
+
+int merkle_root_stream(FILE *fp, size_t record_size, int workers, merkle_proof *proofs, size_t nproofs,
+                       uint8_t root[SHA256_DIGEST_SIZE], size_t *count){
+    // a pipe can't be read back by the workers, so it's read to the end first, like a -c manifest
+    stats_mark mark = stats_begin();
+    buf_t *buf = buf_from_FILE(fp);
+    stats_end(STATS_READ, mark);
+    if(buf == NULL){
+        return -1;
+    }
+    if(record_size == 0){
+        int result = merkle_root_lines(buf, workers, proofs, nproofs, root, count);
+        freeBuf(buf);
+        return result;
+    }
+
+    size_t n = (buf->file_size + record_size - 1) / record_size;
+    const uint8_t **leaves = malloc(sizeof(uint8_t *) * (n ? n : 1));
+    size_t *lens = malloc(sizeof(size_t) * (n ? n : 1));
+    if(leaves == NULL || lens == NULL){
+        perror("malloc failed, in function merkle_root_stream");
+        exit(1);
+    }
+    for(size_t i = 0; i < n; ++i){
+        leaves[i] = (const uint8_t *)&buf->arena[i * record_size];
+        lens[i] = i + 1 < n ? record_size : buf->file_size - i * record_size;
+    }
+    *count = n;
+    int result = merkle_root(leaves, lens, n, workers, proofs, nproofs, root);
+    free(leaves);
+    free(lens);
+    freeBuf(buf);
+    return result;
+}
+
+int merkle_verify(const merkle_proof *proof, const uint8_t root[SHA256_DIGEST_SIZE]){
+    uint8_t node[1 + 2 * SHA256_DIGEST_SIZE];
+    uint8_t hash[SHA256_DIGEST_SIZE];
+    memcpy(hash, proof->leaf, SHA256_DIGEST_SIZE);
+    node[0] = TREE_NODE_PREFIX;
+    for(size_t i = 0; i < proof->steps; ++i){
+        int left = proof->sides[i] == 'L';
+        memcpy(&node[1], left ? proof->siblings[i] : hash, SHA256_DIGEST_SIZE);
+        memcpy(&node[1 + SHA256_DIGEST_SIZE], left ? hash : proof->siblings[i], SHA256_DIGEST_SIZE);
+        sha256(node, sizeof(node), hash);
+    }
+    return memcmp(hash, root, SHA256_DIGEST_SIZE) == 0 ? 0 : -1;
+}
+
+// enough leaves for a few windows and a last one that isn't full, the reference is tree_reduce() over
+// leaves hashed one by one
+int merkle_self_test(void){
+    enum { COUNT = 5 * MERKLE_WINDOW_MIN + 3, PROOFS = 6 };
+    uint8_t *data = malloc(COUNT + 128);
+    const uint8_t **leaves = malloc(COUNT * sizeof(uint8_t *));
+    size_t *lens = malloc(COUNT * sizeof(size_t));
+    uint8_t (*expected)[SHA256_DIGEST_SIZE] = malloc(COUNT * SHA256_DIGEST_SIZE);
+    if(data == NULL || leaves == NULL || lens == NULL || expected == NULL){
+        perror("malloc failed, in function merkle_self_test");
+        exit(1);
+    }
+    for(size_t i = 0; i < COUNT + 128; ++i){
+        data[i] = (uint8_t)(i * 2654435761u >> 13);
+    }
+    for(size_t i = 0; i < COUNT; ++i){
+        leaves[i] = &data[i];
+        lens[i] = (i * 29) % 120;
+        uint8_t leaf[1 + 128];
+        leaf[0] = TREE_LEAF_PREFIX;
+        memcpy(&leaf[1], leaves[i], lens[i]);
+        sha256(leaf, lens[i] + 1, expected[i]);
+    }
+    uint8_t first_leaf[SHA256_DIGEST_SIZE];
+    memcpy(first_leaf, expected[0], SHA256_DIGEST_SIZE);
+    uint8_t reference[SHA256_DIGEST_SIZE];
+    tree_reduce(expected, COUNT, reference);
+
+    merkle_proof proofs[PROOFS] = { { .index = 0 }, { .index = MERKLE_WINDOW_MIN - 1 }, { .index = MERKLE_WINDOW_MIN },
+                                    { .index = 2500 }, { .index = COUNT - 2 }, { .index = COUNT - 1 } };
+    uint8_t root[SHA256_DIGEST_SIZE];
+    int failures = 0;
+    if(merkle_root(leaves, lens, COUNT, 4, proofs, PROOFS, root) != 0 ||
+       memcmp(root, reference, SHA256_DIGEST_SIZE) != 0){
+        failures++;
+    }
+    for(size_t p = 0; p < PROOFS && failures == 0; ++p){
+        if(merkle_verify(&proofs[p], root) != 0){
+            failures++;
+        }
+        // and a proof for another leaf must not pass
+        proofs[p].leaf[0] ^= 1;
+        if(merkle_verify(&proofs[p], root) == 0){
+            failures++;
+        }
+    }
+    // a single leaf is the root
+    if(merkle_root(leaves, lens, 1, 1, NULL, 0, root) != 0 || memcmp(root, first_leaf, SHA256_DIGEST_SIZE) != 0){
+        failures++;
+    }
+
+    printf("self-test: %-8s %s\n", "merkle", failures ? "FAILED" : "OK");
+    free(data);
+    free(leaves);
+    free(lens);
+    free(expected);
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,56 @@
+#ifndef MERKLE_H
+#define MERKLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+#include "buffer.h"
+
+/*
+ * File Description : Merkle root of a list of leaves, one per line of a text file or one per fixed size
+ * record of a binary file, with the same nodes as the tree hash (tree.h):
+ *   leaf  = SHA256(0x00 || leaf bytes)         a line without its "\n" (or "\r\n")
+ *   node  = SHA256(0x01 || left || right)      a node without a pair goes up unchanged
+ * the leaves are cut in windows of a power of two, so each window is a whole subtree that one worker
+ * hashes and reduces level by level on its own, only the window roots are kept for the last levels
+*/
+
+// leaves per window, less when that would leave workers without a window
+#define MERKLE_WINDOW (1 << 16)
+#define MERKLE_WINDOW_MIN (1 << 10)
+// the records of a window are read at once, so the window is smaller for big records
+#define MERKLE_WINDOW_BYTES (8 * 1024 * 1024)
+// a level per bit of the leaf index
+#define MERKLE_MAX_DEPTH 64
+
+// the path from a leaf to the root, asked for before building the tree
+typedef struct Merkle_proof {
+    // which leaf, set by the caller
+    size_t index;
+    // SHA256(0x00 || leaf)
+    uint8_t leaf[SHA256_DIGEST_SIZE];
+    // the sibling of every level from the leaf up, the levels where the node went up unchanged have none
+    size_t steps;
+    uint8_t siblings[MERKLE_MAX_DEPTH][SHA256_DIGEST_SIZE];
+    // 'L' when the sibling is on the left, 'R' when it's on the right
+    char sides[MERKLE_MAX_DEPTH];
+} merkle_proof;
+
+// Root of n leaves in memory, the proofs are filled for their index, -1 on errors (no leaves, an index past the
+// last leaf, threads that couldn't be made)
+int merkle_root(const uint8_t *const *leaves, const size_t *lens, size_t n, int workers, merkle_proof *proofs,
+                size_t nproofs, uint8_t root[SHA256_DIGEST_SIZE]);
+// Root with a leaf per line of the buffer (loadFile() or readFile()), the amount of leaves goes to *count
+int merkle_root_lines(buf_t *buf, int workers, merkle_proof *proofs, size_t nproofs,
+                      uint8_t root[SHA256_DIGEST_SIZE], size_t *count);
+// Root with a leaf per record_size bytes of the file (the last one can be shorter), read with pread by the workers
+int merkle_root_records(const char *path, size_t record_size, int workers, merkle_proof *proofs, size_t nproofs,
+                        uint8_t root[SHA256_DIGEST_SIZE], size_t *count);
+// Either of the two over a stream (stdin, a pipe), a leaf per line when record_size is 0, read to the end first
+int merkle_root_stream(FILE *fp, size_t record_size, int workers, merkle_proof *proofs, size_t nproofs,
+                       uint8_t root[SHA256_DIGEST_SIZE], size_t *count);
+// 0 when the proof leads to root
+int merkle_verify(const merkle_proof *proof, const uint8_t root[SHA256_DIGEST_SIZE]);
+// Checks the windowed roots and the proofs against a plain reduction, prints the result, 0 when they matched
+int merkle_self_test(void);
+#endif
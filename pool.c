@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "pool.h"
+
+/*
+ * File Description : work stealing thread pool
+ * the tasks are dealt to the workers like cards (worker i gets i, i + workers, ...), each worker takes
+ * from the front of its own queue and steals from the back of the others, the queues never grow so a
+ * mutex per queue is enough
+*/
+
+// the tasks of one worker, the positions head..tail-1 of its stripe are still waiting
+typedef struct Pool_queue {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} pool_queue;
+
+typedef struct Pool {
+    pool_queue *queues;
+    int workers;
+    const size_t *order;
+    pool_task_fn task;
+    void *ctx;
+} pool_t;
+
+typedef struct Pool_worker {
+    pool_t *pool;
+    int id;
+} pool_worker;
+
+int pool_default_workers(void){
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// takes the next task from the own queue
+static int pool_pop(pool_queue *q, size_t *slot){
+    int found = 0;
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail){
+        *slot = q->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+// takes the last task from someone else's queue, the ones that would be done last by its owner
+static int pool_steal(pool_queue *q, size_t *slot){
+    int found = 0;
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail){
+        *slot = --q->tail;
+        found = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+static void *pool_worker_main(void *arg){
+    pool_worker *self = arg;
+    pool_t *pool = self->pool;
+
+    for(;;){
+        size_t slot;
+        int owner = self->id;
+        int found = pool_pop(&pool->queues[owner], &slot);
+        // own queue is empty, looking at the others, starting by the neighbour
+        for(int i = 1; !found && i < pool->workers; ++i){
+            owner = (self->id + i) % pool->workers;
+            found = pool_steal(&pool->queues[owner], &slot);
+        }
+        // the queues only shrink, so if every one of them is empty the work is over
+        if(!found){
+            break;
+        }
+        // from the position on the stripe to the position on the hole list
+        slot = owner + slot * pool->workers;
+        pool->task(pool->order ? pool->order[slot] : slot, pool->ctx);
+    }
+    return NULL;
+}
+
+int pool_run(int workers, size_t n, const size_t *order, pool_task_fn task, void *ctx){
+    if(n == 0){
+        return 0;
+    }
+    if(workers < 1){
+        workers = 1;
+    }
+    if((size_t)workers > n){
+        workers = (int)n;
+    }
+
+    // a single worker doesn't need any thread
+    if(workers == 1){
+        for(size_t i = 0; i < n; ++i){
+            task(order ? order[i] : i, ctx);
+        }
+        return 0;
+    }
+
+    pool_t pool = { .workers = workers, .order = order, .task = task, .ctx = ctx };
+    pool.queues = malloc(sizeof(pool_queue) * workers);
+    pool_worker *self = malloc(sizeof(pool_worker) * workers);
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    if(!pool.queues || !self || !threads){
+        perror("malloc failed, in function pool_run");
+        free(pool.queues);
+        free(self);
+        free(threads);
+        return -1;
+    }
+
+    // dealing the tasks, so all the workers start by the first ones of the order
+    for(int i = 0; i < workers; ++i){
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].head = 0;
+        pool.queues[i].tail = (n - i + workers - 1) / workers;
+        self[i].pool = &pool;
+        self[i].id = i;
+    }
+
+    // the calling thread works as worker 0
+    int started = 1;
+    for(int i = 1; i < workers; ++i){
+        if(pthread_create(&threads[i], NULL, pool_worker_main, &self[i]) != 0){
+            perror("pthread_create failed, in function pool_run");
+            break;
+        }
+        started++;
+    }
+    // the queues of threads that failed to start still get stolen by the ones running, so every task is
+    // done and the run is a success, only slower
+    pool_worker_main(&self[0]);
+    for(int i = 1; i < started; ++i){
+        pthread_join(threads[i], NULL);
+    }
+
+    for(int i = 0; i < workers; ++i){
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    free(pool.queues);
+    free(self);
+    free(threads);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/*
+ * File Description : a small work stealing thread pool, each worker has its own queue of task indexes
+ * and takes from the others when its own is empty, so one slow task doesn't hold the rest
+*/
+
+// what a worker runs, index is the task number and ctx is whatever was given to pool_run()
+typedef void (*pool_task_fn)(size_t index, void *ctx);
+
+// The amount of cpus online, used as the default amount of workers
+int pool_default_workers(void);
+// Runs task(i, ctx) for every task, in the order given by order (or 0..n-1 when it's NULL),
+// returns 0 when all of them are done, even on fewer threads than asked when some couldn't be created,
+// -1 when nothing ran because the queues couldn't be allocated
+int pool_run(int workers, size_t n, const size_t *order, pool_task_fn task, void *ctx);
+#endif
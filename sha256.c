@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sha256.h"
+#include "sha256_kernels.h"
+// sha256_K and sha256_H, generated at build time by gen_constants
+#include "sha256_constants.h"
+
+/*
+ * File Description : SHA-256 core, the block functions and the streaming context
+*/
+
+// binary = 1000, dec = 8
+#define BIT_1 0x80
+// binary = 0000, dec = 0
+#define BIT_0 0x00
+
+// macro to implement right rotation
+//#define right_rotate_asm(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#ifdef _WIN32
+// Windows version (no GCC-style inline assembly)
+// Use pure C version
+#define right_rotate_asm(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+#else
+// Linux, WSL, Mac (GCC/Clang)
+static inline uint32_t right_rotate_asm(uint32_t x, uint32_t n){
+    __asm__("rorl %1, %0"
+            : "+r" (x)
+            : "cI" (n)
+            );
+    return x;
+}
+#define RIGHT_ROTATE(x,n) right_rotate_asm((x),(n))
+#endif
+
+// the round constants, the table is generated with the build, so there's nothing to compute at startup
+static const uint32_t *const K = sha256_K;
+// the kernel used by the context, chosen by sha256_setup()
+static sha256_blocks_fn blocks_kernel = sha256_blocks_scalar;
+static sha256_rounds_fn rounds_kernel = sha256_rounds_scalar;
+static sha256_kernel current_kernel = SHA256_KERNEL_SCALAR;
+static pthread_once_t setup_once = PTHREAD_ONCE_INIT;
+
+static void use_kernel(sha256_kernel kernel){
+    switch(kernel){
+        case SHA256_KERNEL_SCALAR:
+            blocks_kernel = sha256_blocks_scalar;
+            rounds_kernel = sha256_rounds_scalar;
+            break;
+        case SHA256_KERNEL_SHANI:
+#ifdef SHA256_HAVE_X86
+            blocks_kernel = sha256_blocks_shani;
+            rounds_kernel = sha256_rounds_shani;
+#endif
+            break;
+    }
+    current_kernel = kernel;
+}
+
+static void pick_kernel(void){
+    if(sha256_kernel_available(SHA256_KERNEL_SHANI)){
+        use_kernel(SHA256_KERNEL_SHANI);
+    }
+}
+
+// picking the fastest kernel, pthread_once() makes the threads that get here first at the same time wait
+// for the one that picks, and every thread sees the kernel it picked
+void sha256_setup(void){
+    pthread_once(&setup_once, pick_kernel);
+}
+
+// checks if the cpu can run a kernel
+int sha256_kernel_available(sha256_kernel kernel){
+    switch(kernel){
+        case SHA256_KERNEL_SCALAR:
+            return 1;
+        case SHA256_KERNEL_SHANI:
+#ifdef SHA256_HAVE_X86
+            return sha256_cpu_has_shani();
+#else
+            return 0;
+#endif
+    }
+    return 0;
+}
+
+// forces one kernel, returns -1 if the cpu doesn't support it
+int sha256_select_kernel(sha256_kernel kernel){
+    if(!sha256_kernel_available(kernel)){
+        return -1;
+    }
+    // after the automatic pick, so a later sha256_setup() doesn't undo this one
+    sha256_setup();
+    use_kernel(kernel);
+    return 0;
+}
+
+sha256_kernel sha256_current_kernel(void){
+    return current_kernel;
+}
+
+const char *sha256_kernel_name(sha256_kernel kernel){
+    switch(kernel){
+        case SHA256_KERNEL_SCALAR:
+            return "scalar";
+        case SHA256_KERNEL_SHANI:
+            return "sha-ni";
+    }
+    return "unknown";
+}
+
+static inline uint32_t sigma0(uint32_t x){
+    return right_rotate_asm(x, 7) ^ right_rotate_asm(x, 18) ^ (x >> 3);
+}
+
+static inline uint32_t sigma1(uint32_t x){
+    return right_rotate_asm(x, 17) ^ right_rotate_asm(x, 19) ^ (x >> 10);
+}
+
+// Expand message schedule
+static void process(const uint8_t *processed_data, uint32_t *w){
+    // Load the first 16 words
+    for(int i = 0; i < 16; ++i){
+        int j = i * 4;
+        w[i] = ((uint32_t)processed_data[j] << 24) | (processed_data[j+1] << 16) | (processed_data[j+2] << 8) | processed_data[j+3];
+    }
+
+    // Expand words 16..63
+    for(int i = 16; i < 64; ++i){
+        w[i] = sigma1(w[i-2]) + w[i-7] + sigma0(w[i-15]) + w[i-16];
+    }
+}
+
+// compression loop
+static void compress(uint32_t *w, uint32_t *hash, const uint32_t *K){
+    // getting my initial values
+    uint32_t a = hash[0];
+    uint32_t b = hash[1];
+    uint32_t c = hash[2];
+    uint32_t d = hash[3];
+    uint32_t e = hash[4];
+    uint32_t f = hash[5];
+    uint32_t g = hash[6];
+    uint32_t h = hash[7];
+
+    // doing the compression
+    for(int i = 0; i < 64; ++i){
+        uint32_t S1 = right_rotate_asm(e,6) ^ right_rotate_asm(e,11) ^ right_rotate_asm(e,25);
+        uint32_t ch = (e & f) ^ ((~e) & g);
+        uint32_t temp1 = h + S1 + ch + K[i] + w[i];
+
+        uint32_t S0 = right_rotate_asm(a,2) ^ right_rotate_asm(a,13) ^ right_rotate_asm(a,22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = S0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    hash[0] += a;
+    hash[1] += b;
+    hash[2] += c;
+    hash[3] += d;
+    hash[4] += e;
+    hash[5] += f;
+    hash[6] += g;
+    hash[7] += h;
+}
+
+// runs process() and compress() over nblocks consecutive blocks
+void sha256_blocks_scalar(uint32_t *hash, const uint8_t *data, size_t nblocks, const uint32_t *K){
+    uint32_t w[64];
+    for(size_t i = 0; i < nblocks; ++i){
+        process(&data[i * SHA256_BLOCK_SIZE], w);
+        compress(w, hash, K);
+    }
+}
+
+// compress() with K and W already added, for the blocks known before the message is
+void sha256_rounds_scalar(uint32_t *hash, const uint32_t *wk){
+    uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3];
+    uint32_t e = hash[4], f = hash[5], g = hash[6], h = hash[7];
+
+    for(int i = 0; i < 64; ++i){
+        uint32_t S1 = right_rotate_asm(e,6) ^ right_rotate_asm(e,11) ^ right_rotate_asm(e,25);
+        uint32_t ch = (e & f) ^ ((~e) & g);
+        uint32_t temp1 = h + S1 + ch + wk[i];
+
+        uint32_t S0 = right_rotate_asm(a,2) ^ right_rotate_asm(a,13) ^ right_rotate_asm(a,22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = S0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    hash[0] += a;
+    hash[1] += b;
+    hash[2] += c;
+    hash[3] += d;
+    hash[4] += e;
+    hash[5] += f;
+    hash[6] += g;
+    hash[7] += h;
+}
+
+// goes through whatever kernel was selected
+static inline void sha256_blocks(uint32_t *hash, const uint8_t *data, size_t nblocks){
+    blocks_kernel(hash, data, nblocks, K);
+}
+
+void sha256_compress_blocks(uint32_t *hash, const uint8_t *data, size_t nblocks){
+    sha256_blocks(hash, data, nblocks);
+}
+
+// setting the initial values
+void sha256_init(sha256_ctx *ctx){
+    // in case the caller never called the setup
+    sha256_setup();
+
+    memcpy(ctx->hash, sha256_H, sizeof(sha256_H));
+    ctx->block_len = 0;
+    ctx->total_len = 0;
+}
+
+// feeding data, whole blocks go straight to the compression, only the leftover gets copied
+void sha256_update(sha256_ctx *ctx, const void *data, size_t len){
+    const uint8_t *bytes = data;
+    ctx->total_len += len;
+
+    // first I try to complete the partial block
+    if(ctx->block_len > 0){
+        size_t missing = SHA256_BLOCK_SIZE - ctx->block_len;
+        size_t take = len < missing ? len : missing;
+        memcpy(&ctx->block[ctx->block_len], bytes, take);
+        ctx->block_len += take;
+        bytes += take;
+        len -= take;
+        // still not a full block, nothing else to do
+        if(ctx->block_len < SHA256_BLOCK_SIZE){
+            return;
+        }
+        sha256_blocks(ctx->hash, ctx->block, 1);
+        ctx->block_len = 0;
+    }
+
+    // hashing directly from the caller memory
+    size_t nblocks = len / SHA256_BLOCK_SIZE;
+    if(nblocks > 0){
+        sha256_blocks(ctx->hash, bytes, nblocks);
+        bytes += nblocks * SHA256_BLOCK_SIZE;
+        len -= nblocks * SHA256_BLOCK_SIZE;
+    }
+
+    // saving what's left for the next call
+    memcpy(ctx->block, bytes, len);
+    ctx->block_len = len;
+}
+
+// the padding, done only over the last block, instead of the hole message
+void sha256_final(sha256_ctx *ctx, uint8_t digest[SHA256_DIGEST_SIZE]){
+    uint8_t last[2 * SHA256_BLOCK_SIZE];
+    size_t nblocks = sha256_pad_tail(last, ctx->block, ctx->block_len, ctx->total_len);
+    sha256_blocks(ctx->hash, last, nblocks);
+    sha256_store_digest(ctx->hash, digest);
+    ctx->block_len = 0;
+}
+
+// builds the last one or two blocks: the leftover bytes, 0x80, the 0x00 and the size in bits
+size_t sha256_pad_tail(uint8_t out[2 * SHA256_BLOCK_SIZE], const uint8_t *tail, size_t tail_len, uint64_t total_len){
+    // this holds the length, in bits
+    uint64_t bit_len = total_len * 8;
+    // case there isn't space for the size after the 0x80, I need one more block
+    size_t size = tail_len + 1 > 56 ? 2 * SHA256_BLOCK_SIZE : SHA256_BLOCK_SIZE;
+
+    memcpy(out, tail, tail_len);
+    // appending 0x80 at the right next available space
+    out[tail_len] = BIT_1;
+    // appending the 0x00 until the size
+    memset(&out[tail_len + 1], BIT_0, size - 8 - (tail_len + 1));
+    // the size goes in big endian at the last 8 bytes
+    for(int i = 7; i >= 0; --i){
+        out[size - 8 + (7 - i)] = (bit_len >> (i * 8)) & 0xFF;
+    }
+    return size / SHA256_BLOCK_SIZE;
+}
+
+// the digest is the hash values in big endian
+void sha256_store_digest(const uint32_t hash[8], uint8_t digest[SHA256_DIGEST_SIZE]){
+    for(int i = 0; i < 8; ++i){
+        digest[i * 4]     = (hash[i] >> 24) & 0xFF;
+        digest[i * 4 + 1] = (hash[i] >> 16) & 0xFF;
+        digest[i * 4 + 2] = (hash[i] >> 8) & 0xFF;
+        digest[i * 4 + 3] = hash[i] & 0xFF;
+    }
+}
+
+// the round constants, for the kernels that live outside this file
+const uint32_t *sha256_round_constants(void){
+    return K;
+}
+
+// the partial block isn't part of the midstate, the caller gets its size back to feed it again
+size_t sha256_export_midstate(const sha256_ctx *ctx, sha256_midstate *mid){
+    memcpy(mid->hash, ctx->hash, sizeof(mid->hash));
+    mid->length = ctx->total_len - ctx->block_len;
+    return ctx->block_len;
+}
+
+void sha256_import_midstate(sha256_ctx *ctx, const sha256_midstate *mid){
+    sha256_setup();
+    memcpy(ctx->hash, mid->hash, sizeof(ctx->hash));
+    ctx->block_len = 0;
+    ctx->total_len = mid->length;
+}
+
+void sha256_midstate_serialize(const sha256_midstate *mid, uint8_t out[SHA256_MIDSTATE_SIZE]){
+    sha256_store_digest(mid->hash, out);
+    for(int i = 7; i >= 0; --i){
+        out[SHA256_DIGEST_SIZE + (7 - i)] = (mid->length >> (i * 8)) & 0xFF;
+    }
+}
+
+int sha256_midstate_deserialize(sha256_midstate *mid, const uint8_t in[SHA256_MIDSTATE_SIZE]){
+    for(int i = 0; i < 8; ++i){
+        mid->hash[i] = ((uint32_t)in[i * 4] << 24) | ((uint32_t)in[i * 4 + 1] << 16) |
+                       ((uint32_t)in[i * 4 + 2] << 8) | in[i * 4 + 3];
+    }
+    mid->length = 0;
+    for(int i = 0; i < 8; ++i){
+        mid->length = (mid->length << 8) | in[SHA256_DIGEST_SIZE + i];
+    }
+    return mid->length % SHA256_BLOCK_SIZE == 0 ? 0 : -1;
+}
+
+// hashing a message that's all in memory
+void sha256(const void *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]){
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, digest);
+}
+
+// the second half of the only block of a 32 byte message: 0x80, zeros and 256 bits as the size
+static const uint8_t pad32_tail[SHA256_BLOCK_SIZE - 32] = {
+    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x00,
+};
+
+void sha256_32(const uint8_t in[32], uint8_t digest[SHA256_DIGEST_SIZE]){
+    sha256_setup();
+    uint32_t hash[8];
+    uint8_t block[SHA256_BLOCK_SIZE];
+    memcpy(hash, sha256_H, sizeof(hash));
+    memcpy(block, in, 32);
+    memcpy(&block[32], pad32_tail, sizeof(pad32_tail));
+    sha256_blocks(hash, block, 1);
+    sha256_store_digest(hash, digest);
+}
+
+// the message block straight from the input, the padding block has its schedule from the build
+void sha256_64(const uint8_t in[64], uint8_t digest[SHA256_DIGEST_SIZE]){
+    sha256_setup();
+    uint32_t hash[8];
+    memcpy(hash, sha256_H, sizeof(hash));
+    sha256_blocks(hash, in, 1);
+    rounds_kernel(hash, sha256_pad64_wk);
+    sha256_store_digest(hash, digest);
+}
+
+void sha256d(const void *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]){
+    uint8_t first[SHA256_DIGEST_SIZE];
+    sha256(data, len, first);
+    sha256_32(first, digest);
+}
+
+void sha256d_64(const uint8_t in[64], uint8_t digest[SHA256_DIGEST_SIZE]){
+    uint8_t first[SHA256_DIGEST_SIZE];
+    sha256_64(in, first);
+    sha256_32(first, digest);
+}
+
+// the digest in the same format that was printed before
+void sha256_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char out[2 * SHA256_DIGEST_SIZE + 1]){
+    static const char hex[] = "0123456789abcdef";
+    for(int i = 0; i < SHA256_DIGEST_SIZE; ++i){
+        out[i * 2] = hex[digest[i] >> 4];
+        out[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+    out[2 * SHA256_DIGEST_SIZE] = '\0';
+}
+
+// compares every available kernel against the scalar one, and the scalar one against known digests
+int sha256_self_test(void){
+    sha256_setup();
+    sha256_kernel saved = current_kernel;
+    int failures = 0;
+
+    // known answers, "" and "abc"
+    static const char *known[][2] = {
+        { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    };
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    char hex[2 * SHA256_DIGEST_SIZE + 1];
+
+    // a message long enough to have many blocks, with every length up to it being tested
+    enum { MAX_LEN = 1024 + 17 };
+    static uint8_t message[MAX_LEN];
+    for(size_t i = 0; i < MAX_LEN; ++i){
+        message[i] = (uint8_t)(i * 131 + (i >> 8) * 7 + 1);
+    }
+
+    for(int k = SHA256_KERNEL_SCALAR; k <= SHA256_KERNEL_SHANI; ++k){
+        if(sha256_select_kernel((sha256_kernel)k) != 0){
+            printf("self-test: %-8s not supported on this cpu, skipped\n", sha256_kernel_name((sha256_kernel)k));
+            continue;
+        }
+        int kernel_failures = 0;
+
+        for(size_t i = 0; i < sizeof(known) / sizeof(known[0]); ++i){
+            sha256(known[i][0], strlen(known[i][0]), digest);
+            sha256_hex(digest, hex);
+            if(strcmp(hex, known[i][1]) != 0){
+                kernel_failures++;
+            }
+        }
+
+        // every other kernel has to agree with the scalar one, byte by byte
+        for(size_t len = 0; len <= MAX_LEN; ++len){
+            uint8_t expected[SHA256_DIGEST_SIZE];
+            sha256_select_kernel(SHA256_KERNEL_SCALAR);
+            sha256(message, len, expected);
+            sha256_select_kernel((sha256_kernel)k);
+            sha256(message, len, digest);
+            if(memcmp(expected, digest, SHA256_DIGEST_SIZE) != 0){
+                kernel_failures++;
+            }
+        }
+
+        // the fixed size entry points against the generic path
+        for(size_t offset = 0; offset < 256; offset += 32){
+            uint8_t expected[SHA256_DIGEST_SIZE], twice[SHA256_DIGEST_SIZE];
+            sha256(&message[offset], 32, expected);
+            sha256_32(&message[offset], digest);
+            kernel_failures += memcmp(expected, digest, SHA256_DIGEST_SIZE) != 0;
+            sha256(&message[offset], 64, expected);
+            sha256_64(&message[offset], digest);
+            kernel_failures += memcmp(expected, digest, SHA256_DIGEST_SIZE) != 0;
+            sha256(expected, SHA256_DIGEST_SIZE, twice);
+            sha256d_64(&message[offset], digest);
+            kernel_failures += memcmp(twice, digest, SHA256_DIGEST_SIZE) != 0;
+        }
+
+        printf("self-test: %-8s %s\n", sha256_kernel_name((sha256_kernel)k), kernel_failures ? "FAILED" : "OK");
+        failures += kernel_failures;
+    }
+
+    // a prefix hashed once, exported, serialized and continued has to give the same digest as the hole message
+    int midstate_failures = 0;
+    for(size_t prefix = 0; prefix <= 200; prefix += 25){
+        sha256_ctx ctx;
+        sha256_midstate mid, back;
+        uint8_t bytes[SHA256_MIDSTATE_SIZE];
+        uint8_t expected[SHA256_DIGEST_SIZE];
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, message, prefix);
+        size_t pending = sha256_export_midstate(&ctx, &mid);
+        sha256_midstate_serialize(&mid, bytes);
+        if(sha256_midstate_deserialize(&back, bytes) != 0){
+            midstate_failures++;
+            continue;
+        }
+        sha256_import_midstate(&ctx, &back);
+        sha256_update(&ctx, &message[prefix - pending], pending + 300);
+        sha256_final(&ctx, digest);
+        sha256(message, prefix + 300, expected);
+        if(memcmp(expected, digest, SHA256_DIGEST_SIZE) != 0){
+            midstate_failures++;
+        }
+    }
+    printf("self-test: %-8s %s\n", "midstate", midstate_failures ? "FAILED" : "OK");
+    failures += midstate_failures;
+
+    sha256_select_kernel(saved);
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,86 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256_api.h"
+
+/*
+ * File Description : SHA-256 core, streaming init/update/final interface on top of process() and compress()
+ * the context only keeps one partial block around, so the memory used doesn't depend on the input size
+*/
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+
+// The hashing state of a single message
+typedef struct Sha256_ctx {
+    // the running hash values, a..h gets added here after every block
+    uint32_t hash[8];
+    // bytes that didn't fill a complete block yet
+    uint8_t block[SHA256_BLOCK_SIZE];
+    // how many bytes are waiting on block
+    size_t block_len;
+    // total amount of bytes fed to the context, needed for the padding
+    uint64_t total_len;
+} sha256_ctx;
+
+// The compression kernels that can be picked at runtime
+typedef enum {
+    SHA256_KERNEL_SCALAR,
+    SHA256_KERNEL_SHANI,
+} sha256_kernel;
+
+// The state after some whole blocks, enough to continue the hash somewhere else,
+// for messages that share a prefix the prefix is hashed once and every message starts from here
+typedef struct Sha256_midstate {
+    uint32_t hash[8];
+    // bytes already compressed, always a multiple of 64
+    uint64_t length;
+} sha256_midstate;
+
+// size of a serialized midstate: the 8 words and the length, big endian
+#define SHA256_MIDSTATE_SIZE 40
+
+// Selects the fastest kernel (the round constants are generated at build time), the hashing functions call it
+// themselves, safe to call from any thread and as many times as wanted
+SHA256_API void sha256_setup(void);
+// Returns 1 if the cpu can run the kernel
+SHA256_API int sha256_kernel_available(sha256_kernel kernel);
+// Forces a kernel, returns -1 if it isn't available, not to be called while other threads are hashing
+SHA256_API int sha256_select_kernel(sha256_kernel kernel);
+// The kernel being used right now
+SHA256_API sha256_kernel sha256_current_kernel(void);
+// A printable name for the kernel
+SHA256_API const char *sha256_kernel_name(sha256_kernel kernel);
+// Checks that every available kernel gives the same digests as the scalar one, returns 0 when they do
+int sha256_self_test(void);
+// Sets the context to the initial hash values
+SHA256_API void sha256_init(sha256_ctx *ctx);
+// Feeds len bytes to the context, can be called as many times as needed
+SHA256_API void sha256_update(sha256_ctx *ctx, const void *data, size_t len);
+// Pads the last block, and writes the digest
+SHA256_API void sha256_final(sha256_ctx *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Saves the state of the context, returns how many of the last bytes fed are still on the partial
+// block and not on the midstate (0 when the data fed is a multiple of 64), those must be fed again after
+// sha256_import_midstate()
+SHA256_API size_t sha256_export_midstate(const sha256_ctx *ctx, sha256_midstate *mid);
+// Starts a context from a midstate, as if the bytes it covers had been fed already
+SHA256_API void sha256_import_midstate(sha256_ctx *ctx, const sha256_midstate *mid);
+// The midstate as bytes, to be saved or sent somewhere
+SHA256_API void sha256_midstate_serialize(const sha256_midstate *mid, uint8_t out[SHA256_MIDSTATE_SIZE]);
+// Reads a serialized midstate back, -1 if the length isn't a multiple of 64
+SHA256_API int sha256_midstate_deserialize(sha256_midstate *mid, const uint8_t in[SHA256_MIDSTATE_SIZE]);
+// One shot version, for when the whole message is already in memory
+SHA256_API void sha256(const void *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Fixed size inputs, the padding is a constant instead of being built, and the padding block of a 64 byte
+// message has its schedule computed at build time
+SHA256_API void sha256_32(const uint8_t in[32], uint8_t digest[SHA256_DIGEST_SIZE]);
+SHA256_API void sha256_64(const uint8_t in[64], uint8_t digest[SHA256_DIGEST_SIZE]);
+// SHA256(SHA256(data)) in one call, the second hash goes through sha256_32()
+SHA256_API void sha256d(const void *data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+// the same over 64 bytes, a node of a merkle tree of double hashes
+SHA256_API void sha256d_64(const uint8_t in[64], uint8_t digest[SHA256_DIGEST_SIZE]);
+// Writes the digest as 64 hex characters plus the '\0'
+SHA256_API void sha256_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char out[2 * SHA256_DIGEST_SIZE + 1]);
+#endif
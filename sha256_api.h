@@ -0,0 +1,15 @@
+#ifndef SHA256_API_H
+#define SHA256_API_H
+
+/*
+ * File Description : what libsha256.so exports
+ * the library objects are built with -fvisibility=hidden, so only the functions of the public headers
+ * marked with SHA256_API are seen by the programs that link it, the kernels, the pool and the rest stay inside
+*/
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SHA256_API __attribute__((visibility("default")))
+#else
+#define SHA256_API
+#endif
+#endif
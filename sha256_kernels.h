@@ -0,0 +1,40 @@
+#ifndef SHA256_KERNELS_H
+#define SHA256_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * File Description : the multi block compression kernels, every one of them has the same signature so
+ * sha256.c can pick one at runtime
+*/
+
+// hashes nblocks consecutive 64 byte blocks of data into hash
+typedef void (*sha256_blocks_fn)(uint32_t *hash, const uint8_t *data, size_t nblocks, const uint32_t *K);
+
+// the portable one, process() + compress()
+void sha256_blocks_scalar(uint32_t *hash, const uint8_t *data, size_t nblocks, const uint32_t *K);
+
+// runs the 64 rounds of a block whose schedule is already known, wk[i] is K[i] + W[i]
+typedef void (*sha256_rounds_fn)(uint32_t *hash, const uint32_t *wk);
+void sha256_rounds_scalar(uint32_t *hash, const uint32_t *wk);
+
+// runs the kernel picked by sha256_select_kernel(), for the code that builds its own padded blocks
+void sha256_compress_blocks(uint32_t *hash, const uint8_t *data, size_t nblocks);
+// the round constants K, from the sha256_constants.h that gen_constants writes at build time
+const uint32_t *sha256_round_constants(void);
+// writes the padded last blocks of a message whose leftover (len < 64) is tail, returns 1 or 2 blocks
+size_t sha256_pad_tail(uint8_t out[128], const uint8_t *tail, size_t tail_len, uint64_t total_len);
+// the hash values to the big endian digest
+void sha256_store_digest(const uint32_t hash[8], uint8_t digest[32]);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_HAVE_X86 1
+// uses the sha256rnds2/sha256msg1/sha256msg2 instructions
+void sha256_blocks_shani(uint32_t *hash, const uint8_t *data, size_t nblocks, const uint32_t *K);
+void sha256_rounds_shani(uint32_t *hash, const uint32_t *wk);
+// checks with cpuid if the cpu has the SHA extensions (and the SSE4.1 the kernel also needs)
+int sha256_cpu_has_shani(void);
+#endif
+
+#endif
@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "sha256_mb.h"
+#include "sha256_kernels.h"
+
+/*
+ * File Description : multi buffer SHA-256
+ * the state is kept transposed, state[word][lane], so each vector register holds the same word of
+ * every message, and process()/compress() run once for all the lanes
+*/
+
+#define MB_MAX_LANES 16
+
+// hashes nblocks from every lane, ptrs[lane] must have nblocks * 64 readable bytes
+typedef void (*mb_blocks_fn)(uint32_t *state, const uint8_t *const *ptrs, size_t nblocks, const uint32_t *K);
+
+// one lane of the scheduler
+typedef struct Mb_lane {
+    // index of the message on the lane, -1 when the lane is empty
+    long job;
+    // the next block to be hashed
+    const uint8_t *ptr;
+    // blocks left on the current segment, first the message itself, then the tail
+    size_t blocks;
+    // 1 when ptr points to the tail
+    int on_tail;
+    // the last partial block with the padding
+    uint8_t tail[2 * SHA256_BLOCK_SIZE];
+    size_t tail_blocks;
+} mb_lane;
+
+#ifdef SHA256_HAVE_X86
+#include <immintrin.h>
+
+#define ROR256(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+// 8 lanes, the 16 words of each block are transposed with unpacks, so word i of all lanes ends up on w[i]
+__attribute__((target("avx2")))
+static void sha256_x8_blocks(uint32_t *state, const uint8_t *const *ptrs, size_t nblocks, const uint32_t *K){
+    const __m256i BSWAP = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                          12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i h_state[8];
+    for(int i = 0; i < 8; ++i){
+        h_state[i] = _mm256_load_si256((const __m256i *)&state[i * 8]);
+    }
+
+    for(size_t block = 0; block < nblocks; ++block){
+        __m256i w[16];
+
+        // two 8x8 transposes, words 0..7 and 8..15
+        for(int half = 0; half < 2; ++half){
+            size_t off = block * SHA256_BLOCK_SIZE + half * 32;
+            __m256i r[8], t[8], u[8];
+            for(int l = 0; l < 8; ++l){
+                r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)&ptrs[l][off]), BSWAP);
+            }
+            for(int l = 0; l < 8; l += 2){
+                t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+                t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+            }
+            for(int l = 0; l < 8; l += 4){
+                u[l] = _mm256_unpacklo_epi64(t[l], t[l + 2]);
+                u[l + 1] = _mm256_unpackhi_epi64(t[l], t[l + 2]);
+                u[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+                u[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+            }
+            for(int i = 0; i < 4; ++i){
+                w[half * 8 + i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+                w[half * 8 + i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+            }
+        }
+
+        __m256i a = h_state[0], b = h_state[1], c = h_state[2], d = h_state[3];
+        __m256i e = h_state[4], f = h_state[5], g = h_state[6], h = h_state[7];
+
+        for(int i = 0; i < 64; ++i){
+            // message schedule, only the last 16 words are kept
+            if(i >= 16){
+                __m256i w15 = w[(i - 15) & 15];
+                __m256i w2 = w[(i - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROR256(w15, 7), ROR256(w15, 18)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROR256(w2, 17), ROR256(w2, 19)), _mm256_srli_epi32(w2, 10));
+                w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0), _mm256_add_epi32(w[(i - 7) & 15], s1));
+            }
+
+            __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(ROR256(e, 6), ROR256(e, 11)), ROR256(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, w[i & 15]));
+            temp1 = _mm256_add_epi32(temp1, _mm256_set1_epi32((int)K[i]));
+
+            __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(ROR256(a, 2), ROR256(a, 13)), ROR256(a, 22));
+            __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            __m256i temp2 = _mm256_add_epi32(S0, maj);
+
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, temp1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(temp1, temp2);
+        }
+
+        h_state[0] = _mm256_add_epi32(h_state[0], a);
+        h_state[1] = _mm256_add_epi32(h_state[1], b);
+        h_state[2] = _mm256_add_epi32(h_state[2], c);
+        h_state[3] = _mm256_add_epi32(h_state[3], d);
+        h_state[4] = _mm256_add_epi32(h_state[4], e);
+        h_state[5] = _mm256_add_epi32(h_state[5], f);
+        h_state[6] = _mm256_add_epi32(h_state[6], g);
+        h_state[7] = _mm256_add_epi32(h_state[7], h);
+    }
+
+    for(int i = 0; i < 8; ++i){
+        _mm256_store_si256((__m256i *)&state[i * 8], h_state[i]);
+    }
+}
+
+// 16 lanes, the blocks are copied next to each other and the words are gathered from there,
+// rotations and ch/maj have their own instructions on AVX-512
+__attribute__((target("avx512f,avx512bw")))
+static void sha256_x16_blocks(uint32_t *state, const uint8_t *const *ptrs, size_t nblocks, const uint32_t *K){
+    const __m512i BSWAP = _mm512_set4_epi32(0x0c0d0e0f, 0x08090a0b, 0x04050607, 0x00010203);
+    const __m512i LANE_OFFSETS = _mm512_set_epi32(240, 224, 208, 192, 176, 160, 144, 128, 112, 96, 80, 64, 48, 32, 16, 0);
+    uint32_t staging[16 * 16] __attribute__((aligned(64)));
+    __m512i h_state[8];
+    for(int i = 0; i < 8; ++i){
+        h_state[i] = _mm512_load_si512(&state[i * 16]);
+    }
+
+    for(size_t block = 0; block < nblocks; ++block){
+        for(int l = 0; l < 16; ++l){
+            _mm512_store_si512(&staging[l * 16], _mm512_loadu_si512(&ptrs[l][block * SHA256_BLOCK_SIZE]));
+        }
+        __m512i w[16];
+        for(int i = 0; i < 16; ++i){
+            __m512i idx = _mm512_add_epi32(LANE_OFFSETS, _mm512_set1_epi32(i));
+            w[i] = _mm512_shuffle_epi8(_mm512_i32gather_epi32(idx, staging, 4), BSWAP);
+        }
+
+        __m512i a = h_state[0], b = h_state[1], c = h_state[2], d = h_state[3];
+        __m512i e = h_state[4], f = h_state[5], g = h_state[6], h = h_state[7];
+
+        for(int i = 0; i < 64; ++i){
+            if(i >= 16){
+                __m512i w15 = w[(i - 15) & 15];
+                __m512i w2 = w[(i - 2) & 15];
+                __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18), _mm512_srli_epi32(w15, 3), 0x96);
+                __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19), _mm512_srli_epi32(w2, 10), 0x96);
+                w[i & 15] = _mm512_add_epi32(_mm512_add_epi32(w[i & 15], s0), _mm512_add_epi32(w[(i - 7) & 15], s1));
+            }
+
+            // 0x96 = a ^ b ^ c, 0xCA = a ? b : c, 0xE8 = majority
+            __m512i S1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25), 0x96);
+            __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+            __m512i temp1 = _mm512_add_epi32(_mm512_add_epi32(h, S1), _mm512_add_epi32(ch, w[i & 15]));
+            temp1 = _mm512_add_epi32(temp1, _mm512_set1_epi32((int)K[i]));
+
+            __m512i S0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22), 0x96);
+            __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+            __m512i temp2 = _mm512_add_epi32(S0, maj);
+
+            h = g;
+            g = f;
+            f = e;
+            e = _mm512_add_epi32(d, temp1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm512_add_epi32(temp1, temp2);
+        }
+
+        h_state[0] = _mm512_add_epi32(h_state[0], a);
+        h_state[1] = _mm512_add_epi32(h_state[1], b);
+        h_state[2] = _mm512_add_epi32(h_state[2], c);
+        h_state[3] = _mm512_add_epi32(h_state[3], d);
+        h_state[4] = _mm512_add_epi32(h_state[4], e);
+        h_state[5] = _mm512_add_epi32(h_state[5], f);
+        h_state[6] = _mm512_add_epi32(h_state[6], g);
+        h_state[7] = _mm512_add_epi32(h_state[7], h);
+    }
+
+    for(int i = 0; i < 8; ++i){
+        _mm512_store_si512(&state[i * 16], h_state[i]);
+    }
+}
+
+static int cpu_has_avx2(void){
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static int cpu_has_avx512(void){
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+#endif
+
+// the engine in use, 0 means it wasn't picked yet
+static int mb_lanes = 0;
+static mb_blocks_fn mb_kernel = NULL;
+static pthread_once_t mb_once = PTHREAD_ONCE_INIT;
+
+static int mb_use(int lanes){
+    switch(lanes){
+        case 1:
+            mb_kernel = NULL;
+            break;
+#ifdef SHA256_HAVE_X86
+        case 8:
+            if(!cpu_has_avx2()){
+                return -1;
+            }
+            mb_kernel = sha256_x8_blocks;
+            break;
+        case 16:
+            if(!cpu_has_avx512()){
+                return -1;
+            }
+            mb_kernel = sha256_x16_blocks;
+            break;
+#endif
+        default:
+            return -1;
+    }
+    mb_lanes = lanes;
+    return 0;
+}
+
+// widest first, once, the batch workers that ask at the same time all wait for the same pick
+static void mb_pick(void){
+    if(mb_use(16) != 0 && mb_use(8) != 0){
+        mb_use(1);
+    }
+}
+
+int sha256_mb_select(int lanes){
+    // after the automatic pick, so it doesn't undo this one
+    pthread_once(&mb_once, mb_pick);
+    return mb_use(lanes);
+}
+
+int sha256_mb_lanes(void){
+    pthread_once(&mb_once, mb_pick);
+    return mb_lanes;
+}
+
+const char *sha256_mb_name(void){
+    switch(sha256_mb_lanes()){
+        case 16:
+            return "avx512-x16";
+        case 8:
+            return "avx2-x8";
+    }
+    return "single";
+}
+
+// puts message job on the lane, and sets that lane's column of the state to the starting point
+static void mb_lane_start(mb_lane *lane, uint32_t *state, int lanes, int index, const sha256_midstate *start,
+                          long job, const uint8_t *msg, size_t len){
+    for(int i = 0; i < 8; ++i){
+        state[i * lanes + index] = start->hash[i];
+    }
+
+    size_t full = len / SHA256_BLOCK_SIZE;
+    lane->job = job;
+    // the size on the padding counts the prefix too
+    lane->tail_blocks = sha256_pad_tail(lane->tail, &msg[full * SHA256_BLOCK_SIZE], len % SHA256_BLOCK_SIZE, start->length + len);
+    // messages shorter than a block go directly to the tail
+    if(full > 0){
+        lane->ptr = msg;
+        lane->blocks = full;
+        lane->on_tail = 0;
+    }else{
+        lane->ptr = lane->tail;
+        lane->blocks = lane->tail_blocks;
+        lane->on_tail = 1;
+    }
+}
+
+void sha256_mb_hash(const uint8_t *const *msgs, const size_t *lens, size_t n, uint8_t (*digests)[SHA256_DIGEST_SIZE]){
+    // starting from the initial hash values, with nothing before
+    sha256_ctx initial;
+    sha256_midstate start;
+    sha256_init(&initial);
+    sha256_export_midstate(&initial, &start);
+    sha256_mb_hash_from(&start, msgs, lens, n, digests);
+}
+
+void sha256_mb_hash_from(const sha256_midstate *start, const uint8_t *const *msgs, const size_t *lens, size_t n,
+                         uint8_t (*digests)[SHA256_DIGEST_SIZE]){
+    int lanes = sha256_mb_lanes();
+    // no vector engine, one message at a time
+    if(lanes == 1 || mb_kernel == NULL){
+        for(size_t i = 0; i < n; ++i){
+            sha256_ctx ctx;
+            sha256_import_midstate(&ctx, start);
+            sha256_update(&ctx, msgs[i], lens[i]);
+            sha256_final(&ctx, digests[i]);
+        }
+        return;
+    }
+
+    const uint32_t *K = sha256_round_constants();
+    uint32_t state[8 * MB_MAX_LANES] __attribute__((aligned(64)));
+    mb_lane lane[MB_MAX_LANES];
+    size_t next_job = 0;
+    int active = 0;
+
+    // first fill
+    for(int l = 0; l < lanes; ++l){
+        if(next_job < n){
+            mb_lane_start(&lane[l], state, lanes, l, start, (long)next_job, msgs[next_job], lens[next_job]);
+            next_job++;
+            active++;
+        }else{
+            lane[l].job = -1;
+        }
+    }
+
+    while(active > 0){
+        // every lane moves the same amount of blocks, the smallest segment decides it
+        size_t step = (size_t)-1;
+        const uint8_t *any = NULL;
+        for(int l = 0; l < lanes; ++l){
+            if(lane[l].job >= 0 && lane[l].blocks < step){
+                step = lane[l].blocks;
+                any = lane[l].ptr;
+            }
+        }
+
+        // the empty lanes hash a copy of a busy lane, the result is just ignored
+        const uint8_t *ptrs[MB_MAX_LANES];
+        for(int l = 0; l < lanes; ++l){
+            ptrs[l] = lane[l].job >= 0 ? lane[l].ptr : any;
+        }
+        mb_kernel(state, ptrs, step, K);
+
+        for(int l = 0; l < lanes; ++l){
+            if(lane[l].job < 0){
+                continue;
+            }
+            lane[l].ptr += step * SHA256_BLOCK_SIZE;
+            lane[l].blocks -= step;
+            if(lane[l].blocks > 0){
+                continue;
+            }
+            // the message is over, next comes the tail
+            if(!lane[l].on_tail){
+                lane[l].ptr = lane[l].tail;
+                lane[l].blocks = lane[l].tail_blocks;
+                lane[l].on_tail = 1;
+                continue;
+            }
+
+            // tail is over too, the digest is ready and the lane gets the next message
+            uint32_t hash[8];
+            for(int i = 0; i < 8; ++i){
+                hash[i] = state[i * lanes + l];
+            }
+            sha256_store_digest(hash, digests[lane[l].job]);
+
+            if(next_job < n){
+                mb_lane_start(&lane[l], state, lanes, l, start, (long)next_job, msgs[next_job], lens[next_job]);
+                next_job++;
+            }else{
+                lane[l].job = -1;
+                active--;
+            }
+        }
+    }
+}
+
+// every engine the cpu can run against the one message at a time path, with messages of different lengths
+int sha256_mb_self_test(void){
+    enum { COUNT = 300 };
+    static uint8_t data[COUNT * 2];
+    static uint8_t expected[COUNT][SHA256_DIGEST_SIZE];
+    static uint8_t got[COUNT][SHA256_DIGEST_SIZE];
+    const uint8_t *msgs[COUNT];
+    size_t lens[COUNT];
+
+    for(size_t i = 0; i < sizeof(data); ++i){
+        data[i] = (uint8_t)(i * 37 + 11);
+    }
+    // lengths go up and down so the lanes finish at different times
+    for(size_t i = 0; i < COUNT; ++i){
+        lens[i] = (i * 97) % (COUNT + 1);
+        msgs[i] = &data[i];
+        sha256(msgs[i], lens[i], expected[i]);
+    }
+
+    int saved = sha256_mb_lanes();
+    int failures = 0;
+    static const int engines[] = { 8, 16 };
+    for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); ++e){
+        if(sha256_mb_select(engines[e]) != 0){
+            printf("self-test: %-8s not supported on this cpu, skipped\n", engines[e] == 8 ? "avx2-x8" : "avx512-x16");
+            continue;
+        }
+        int engine_failures = 0;
+        // a few batch sizes, smaller and bigger than the amount of lanes
+        static const size_t batches[] = { 1, 7, 16, 17, COUNT };
+        for(size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); ++b){
+            memset(got, 0, sizeof(got));
+            sha256_mb_hash(msgs, lens, batches[b], got);
+            if(memcmp(got, expected, batches[b] * SHA256_DIGEST_SIZE) != 0){
+                engine_failures++;
+            }
+        }
+        // the same messages after a shared prefix of two blocks
+        sha256_ctx ctx;
+        sha256_midstate mid;
+        sha256_init(&ctx);
+        sha256_update(&ctx, data, 2 * SHA256_BLOCK_SIZE);
+        sha256_export_midstate(&ctx, &mid);
+        sha256_mb_hash_from(&mid, msgs, lens, COUNT, got);
+        for(size_t i = 0; i < COUNT; ++i){
+            uint8_t whole[SHA256_DIGEST_SIZE];
+            sha256_ctx full;
+            sha256_init(&full);
+            sha256_update(&full, data, 2 * SHA256_BLOCK_SIZE);
+            sha256_update(&full, msgs[i], lens[i]);
+            sha256_final(&full, whole);
+            if(memcmp(whole, got[i], SHA256_DIGEST_SIZE) != 0){
+                engine_failures++;
+                break;
+            }
+        }
+        printf("self-test: %-8s %s\n", sha256_mb_name(), engine_failures ? "FAILED" : "OK");
+        failures += engine_failures;
+    }
+
+    sha256_mb_select(saved);
+    return failures == 0 ? 0 : -1;
+}
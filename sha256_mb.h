@@ -0,0 +1,27 @@
+#ifndef SHA256_MB_H
+#define SHA256_MB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : multi buffer engine, hashes many independent messages at the same time, one per
+ * vector lane (8 with AVX2, 16 with AVX-512), lanes get refilled as soon as their message ends
+*/
+
+// Hashes n messages, msgs[i] with lens[i] bytes goes to digests[i]
+SHA256_API void sha256_mb_hash(const uint8_t *const *msgs, const size_t *lens, size_t n, uint8_t (*digests)[SHA256_DIGEST_SIZE]);
+// Same, but every message continues from mid (the shared prefix), digests[i] is the hash of prefix || msgs[i]
+SHA256_API void sha256_mb_hash_from(const sha256_midstate *mid, const uint8_t *const *msgs, const size_t *lens, size_t n,
+                         uint8_t (*digests)[SHA256_DIGEST_SIZE]);
+// How many lanes the best engine on this cpu has, 1 means no vector engine
+SHA256_API int sha256_mb_lanes(void);
+// Forces the engine with that amount of lanes (1, 8 or 16), returns -1 if the cpu can't run it, not to be
+// called while other threads are hashing
+SHA256_API int sha256_mb_select(int lanes);
+// Printable name of the engine being used
+SHA256_API const char *sha256_mb_name(void);
+// Checks every engine the cpu can run against sha256(), returns 0 when they all agree
+int sha256_mb_self_test(void);
+#endif
@@ -0,0 +1,115 @@
+#include "sha256_kernels.h"
+
+/*
+ * File Description : SHA-256 compression using the x86 SHA extensions
+ * the function is compiled with the target attribute, so the rest of the program doesn't need -msha,
+ * it's only called when sha256_cpu_has_shani() says so
+*/
+
+#ifdef SHA256_HAVE_X86
+#include <cpuid.h>
+#include <immintrin.h>
+
+int sha256_cpu_has_shani(void){
+    unsigned int eax, ebx, ecx, edx;
+    // leaf 1, ecx bit 19 = SSE4.1, bit 9 = SSSE3
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)){
+        return 0;
+    }
+    if(!(ecx & (1u << 19)) || !(ecx & (1u << 9))){
+        return 0;
+    }
+    // leaf 7, ebx bit 29 = SHA
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)){
+        return 0;
+    }
+    return (ebx & (1u << 29)) != 0;
+}
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void sha256_blocks_shani(uint32_t *hash, const uint8_t *data, size_t nblocks, const uint32_t *K){
+    // the instructions want the state as ABEF and CDGH instead of ABCD and EFGH
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_loadu_si128((const __m128i *)&hash[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)&hash[4]);
+
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);             // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);       // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);    // CDGH
+
+    for(size_t block = 0; block < nblocks; ++block){
+        const uint8_t *p = &data[block * 64];
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+
+        // the first 16 words, converted to big endian
+        __m128i msg[4];
+        for(int i = 0; i < 4; ++i){
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&p[i * 16]), MASK);
+        }
+
+        // 16 groups of 4 rounds, each rnds2 does 2 of them
+        #pragma GCC unroll 16
+        for(int r = 0; r < 16; ++r){
+            __m128i wk = _mm_add_epi32(msg[r & 3], _mm_loadu_si128((const __m128i *)&K[r * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+
+            // the schedule for words 4 groups ahead, takes the place of the group that was just used
+            if(r < 12){
+                __m128i next = _mm_sha256msg1_epu32(msg[r & 3], msg[(r + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+                msg[r & 3] = _mm_sha256msg2_epu32(next, msg[(r + 3) & 3]);
+            }
+
+            wk = _mm_shuffle_epi32(wk, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    // back to ABCD EFGH
+    tmp = _mm_shuffle_epi32(state0, 0x1B);          // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);       // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);    // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);       // HGFE
+
+    _mm_storeu_si128((__m128i *)&hash[0], state0);
+    _mm_storeu_si128((__m128i *)&hash[4], state1);
+}
+
+// the same rounds without the message, the schedule instructions aren't needed at all
+__attribute__((target("sha,sse4.1,ssse3")))
+void sha256_rounds_shani(uint32_t *hash, const uint32_t *wk){
+    __m128i tmp = _mm_loadu_si128((const __m128i *)&hash[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)&hash[4]);
+
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+    __m128i abef_save = state0;
+    __m128i cdgh_save = state1;
+
+    #pragma GCC unroll 16
+    for(int r = 0; r < 16; ++r){
+        __m128i quad = _mm_loadu_si128((const __m128i *)&wk[r * 4]);
+        state1 = _mm_sha256rnds2_epu32(state1, state0, quad);
+        quad = _mm_shuffle_epi32(quad, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, quad);
+    }
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128((__m128i *)&hash[0], state0);
+    _mm_storeu_si128((__m128i *)&hash[4], state1);
+}
+#endif
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <string.h>
+#include "sha512.h"
+
+/*
+ * File Description : SHA-512, SHA-384 and SHA-512/256
+ * the constants are written out here instead of coming from gen_constants: 64 bits of the fractional part
+ * of a cube root is more than a double (or a long double) can hold, and the SHA-384 and SHA-512/t initial
+ * values aren't the plain square roots anyway
+*/
+
+// first 64 bits of the fractional parts of the cube roots of the first 80 primes
+static const uint64_t K512[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+// the initial values of each variant, in the order of sha512_variant
+static const uint64_t H512[3][8] = {
+    // square roots of the first 8 primes
+    { 0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+      0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL },
+    // square roots of the 9th to the 16th primes
+    { 0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL, 0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+      0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL, 0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL },
+    // the SHA-512/t generation function for t = 256
+    { 0x22312194fc2bf72cULL, 0x9f555fa3c84c64c2ULL, 0x2393b86b6f53b151ULL, 0x963877195940eabdULL,
+      0x96283ee2a88effe3ULL, 0xbe5e1e2553863992ULL, 0x2b0199fc2c85b8aaULL, 0x0eb72ddc81c52ca2ULL },
+};
+
+static const size_t digest_sizes[3] = { 64, 48, 32 };
+static const char *variant_names[3] = { "sha512", "sha384", "sha512-256" };
+
+size_t sha512_digest_size(sha512_variant variant){
+    return digest_sizes[variant];
+}
+
+const char *sha512_variant_name(sha512_variant variant){
+    return variant_names[variant];
+}
+
+int sha512_variant_from_name(const char *name, sha512_variant *variant){
+    for(int i = 0; i < 3; ++i){
+        // "sha512" and "512" both work
+        if(strcmp(name, variant_names[i]) == 0 || strcmp(name, &variant_names[i][3]) == 0){
+            *variant = (sha512_variant)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static inline uint64_t rotr64(uint64_t x, int n){
+    return (x >> n) | (x << (64 - n));
+}
+
+static inline uint64_t load_be64(const uint8_t *p){
+    uint64_t x = 0;
+    for(int i = 0; i < 8; ++i){
+        x = (x << 8) | p[i];
+    }
+    return x;
+}
+
+static inline void store_be64(uint8_t *p, uint64_t x){
+    for(int i = 7; i >= 0; --i){
+        p[7 - i] = (x >> (i * 8)) & 0xFF;
+    }
+}
+
+// one round, the names rotate instead of the values so nothing gets moved around
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, k, w) do { \
+        uint64_t t1 = h + (rotr64(e, 14) ^ rotr64(e, 18) ^ rotr64(e, 41)) + ((e & f) ^ (~e & g)) + k + w; \
+        uint64_t t2 = (rotr64(a, 28) ^ rotr64(a, 34) ^ rotr64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c)); \
+        d += t1; \
+        h = t1 + t2; \
+    } while(0)
+
+// the schedule only keeps the last 16 words, W[i] is made in place of W[i - 16]
+#define SHA512_SCHEDULE(w, i) \
+    (w[(i) & 15] += (rotr64(w[((i) - 2) & 15], 19) ^ rotr64(w[((i) - 2) & 15], 61) ^ (w[((i) - 2) & 15] >> 6)) + \
+                    w[((i) - 7) & 15] + \
+                    (rotr64(w[((i) - 15) & 15], 1) ^ rotr64(w[((i) - 15) & 15], 8) ^ (w[((i) - 15) & 15] >> 7)))
+
+// hashes nblocks consecutive 128 byte blocks into hash
+static void sha512_blocks(uint64_t *hash, const uint8_t *data, size_t nblocks){
+    uint64_t w[16];
+    for(size_t n = 0; n < nblocks; ++n, data += SHA512_BLOCK_SIZE){
+        uint64_t a = hash[0], b = hash[1], c = hash[2], d = hash[3];
+        uint64_t e = hash[4], f = hash[5], g = hash[6], h = hash[7];
+
+        for(int i = 0; i < 16; ++i){
+            w[i] = load_be64(&data[i * 8]);
+        }
+        // 8 rounds per iteration, after them the names are back where they started
+        for(int i = 0; i < 80; i += 8){
+            if(i >= 16){
+                for(int j = 0; j < 8; ++j){
+                    SHA512_SCHEDULE(w, i + j);
+                }
+            }
+            SHA512_ROUND(a, b, c, d, e, f, g, h, K512[i],     w[i & 15]);
+            SHA512_ROUND(h, a, b, c, d, e, f, g, K512[i + 1], w[(i + 1) & 15]);
+            SHA512_ROUND(g, h, a, b, c, d, e, f, K512[i + 2], w[(i + 2) & 15]);
+            SHA512_ROUND(f, g, h, a, b, c, d, e, K512[i + 3], w[(i + 3) & 15]);
+            SHA512_ROUND(e, f, g, h, a, b, c, d, K512[i + 4], w[(i + 4) & 15]);
+            SHA512_ROUND(d, e, f, g, h, a, b, c, K512[i + 5], w[(i + 5) & 15]);
+            SHA512_ROUND(c, d, e, f, g, h, a, b, K512[i + 6], w[(i + 6) & 15]);
+            SHA512_ROUND(b, c, d, e, f, g, h, a, K512[i + 7], w[(i + 7) & 15]);
+        }
+
+        hash[0] += a;
+        hash[1] += b;
+        hash[2] += c;
+        hash[3] += d;
+        hash[4] += e;
+        hash[5] += f;
+        hash[6] += g;
+        hash[7] += h;
+    }
+}
+
+void sha512_init(sha512_ctx *ctx, sha512_variant variant){
+    memcpy(ctx->hash, H512[variant], sizeof(ctx->hash));
+    ctx->block_len = 0;
+    ctx->total_len = 0;
+    ctx->variant = variant;
+}
+
+// same as sha256_update(), whole blocks are hashed from the caller memory
+void sha512_update(sha512_ctx *ctx, const void *data, size_t len){
+    const uint8_t *bytes = data;
+    ctx->total_len += len;
+
+    if(ctx->block_len > 0){
+        size_t missing = SHA512_BLOCK_SIZE - ctx->block_len;
+        size_t take = len < missing ? len : missing;
+        memcpy(&ctx->block[ctx->block_len], bytes, take);
+        ctx->block_len += take;
+        bytes += take;
+        len -= take;
+        if(ctx->block_len < SHA512_BLOCK_SIZE){
+            return;
+        }
+        sha512_blocks(ctx->hash, ctx->block, 1);
+        ctx->block_len = 0;
+    }
+
+    size_t nblocks = len / SHA512_BLOCK_SIZE;
+    if(nblocks > 0){
+        sha512_blocks(ctx->hash, bytes, nblocks);
+        bytes += nblocks * SHA512_BLOCK_SIZE;
+        len -= nblocks * SHA512_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->block, bytes, len);
+    ctx->block_len = len;
+}
+
+// the 0x80, the 0x00 and a 128 bit size, the high 64 bits of it are the bits that don't fit on total_len * 8
+void sha512_final(sha512_ctx *ctx, uint8_t *digest){
+    uint8_t last[2 * SHA512_BLOCK_SIZE];
+    size_t size = ctx->block_len + 1 > SHA512_BLOCK_SIZE - 16 ? 2 * SHA512_BLOCK_SIZE : SHA512_BLOCK_SIZE;
+
+    memcpy(last, ctx->block, ctx->block_len);
+    last[ctx->block_len] = 0x80;
+    memset(&last[ctx->block_len + 1], 0x00, size - 16 - (ctx->block_len + 1));
+    store_be64(&last[size - 16], ctx->total_len >> 61);
+    store_be64(&last[size - 8], ctx->total_len << 3);
+    sha512_blocks(ctx->hash, last, size / SHA512_BLOCK_SIZE);
+
+    // the shorter variants are the first bytes of the same big endian output
+    uint8_t full[SHA512_DIGEST_SIZE];
+    for(int i = 0; i < 8; ++i){
+        store_be64(&full[i * 8], ctx->hash[i]);
+    }
+    memcpy(digest, full, digest_sizes[ctx->variant]);
+    ctx->block_len = 0;
+}
+
+void sha512(sha512_variant variant, const void *data, size_t len, uint8_t *digest){
+    sha512_ctx ctx;
+    sha512_init(&ctx, variant);
+    sha512_update(&ctx, data, len);
+    sha512_final(&ctx, digest);
+}
+
+int sha512_self_test(void){
+    static const struct {
+        sha512_variant variant;
+        const char *message;
+        const char *expected;
+    } vectors[] = {
+        { SHA512_VARIANT_512, "abc",
+          "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+          "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+        { SHA512_VARIANT_512, "",
+          "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+          "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e" },
+        { SHA512_VARIANT_384, "abc",
+          "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed"
+          "8086072ba1e7cc2358baeca134c825a7" },
+        { SHA512_VARIANT_512_256, "abc",
+          "53048e2681941ef99b2e29b76b4c7dabe4c2d0c634fc6d46e0e2f13107e7af23" },
+        // two blocks of padding, 112 bytes leave no room for the size
+        { SHA512_VARIANT_512,
+          "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+          "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+          "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" },
+    };
+
+    int failures = 0;
+    for(size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i){
+        uint8_t digest[SHA512_DIGEST_SIZE];
+        char hex[2 * SHA512_DIGEST_SIZE + 1];
+        size_t size = sha512_digest_size(vectors[i].variant);
+        sha512(vectors[i].variant, vectors[i].message, strlen(vectors[i].message), digest);
+        for(size_t b = 0; b < size; ++b){
+            sprintf(&hex[b * 2], "%02x", digest[b]);
+        }
+        if(strcmp(hex, vectors[i].expected) != 0){
+            failures++;
+        }
+    }
+
+    // one call against the same bytes fed one at a time, every split of the block gets crossed
+    uint8_t message[300];
+    uint8_t one_shot[SHA512_DIGEST_SIZE], streamed[SHA512_DIGEST_SIZE];
+    for(size_t i = 0; i < sizeof(message); ++i){
+        message[i] = (uint8_t)(i * 31 + 7);
+    }
+    sha512(SHA512_VARIANT_512, message, sizeof(message), one_shot);
+    sha512_ctx ctx;
+    sha512_init(&ctx, SHA512_VARIANT_512);
+    for(size_t i = 0; i < sizeof(message); ++i){
+        sha512_update(&ctx, &message[i], 1);
+    }
+    sha512_final(&ctx, streamed);
+    if(memcmp(one_shot, streamed, SHA512_DIGEST_SIZE) != 0){
+        failures++;
+    }
+
+    printf("self-test: %-8s %s\n", "sha512", failures ? "FAILED" : "OK");
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,51 @@
+#ifndef SHA512_H
+#define SHA512_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256_api.h"
+
+/*
+ * File Description : the SHA-512 family (FIPS 180-4), same streaming interface as sha256.h but with 64 bit
+ * words and 128 byte blocks, 80 rounds per block. On 64 bit machines it goes through more bytes per round
+ * than SHA-256 so it's faster on big inputs (unless the cpu has the SHA-256 instructions)
+ * SHA-384 and SHA-512/256 are SHA-512 with other initial values and a shorter digest
+*/
+
+#define SHA512_BLOCK_SIZE 128
+// the biggest digest of the family, enough for any of them
+#define SHA512_DIGEST_SIZE 64
+
+typedef enum {
+    SHA512_VARIANT_512,
+    SHA512_VARIANT_384,
+    SHA512_VARIANT_512_256,
+} sha512_variant;
+
+typedef struct Sha512_ctx {
+    uint64_t hash[8];
+    uint8_t block[SHA512_BLOCK_SIZE];
+    size_t block_len;
+    // the size field of the padding is 128 bits, the high half is always 0 here
+    uint64_t total_len;
+    sha512_variant variant;
+} sha512_ctx;
+
+// Bytes of the digest of the variant, 64, 48 or 32
+SHA256_API size_t sha512_digest_size(sha512_variant variant);
+// "sha512", "sha384" or "sha512-256"
+SHA256_API const char *sha512_variant_name(sha512_variant variant);
+// The variant named like sha512_variant_name() (the "sha" is optional), -1 if there's none
+SHA256_API int sha512_variant_from_name(const char *name, sha512_variant *variant);
+
+SHA256_API void sha512_init(sha512_ctx *ctx, sha512_variant variant);
+SHA256_API void sha512_update(sha512_ctx *ctx, const void *data, size_t len);
+// writes sha512_digest_size() bytes
+SHA256_API void sha512_final(sha512_ctx *ctx, uint8_t *digest);
+// One shot version
+SHA256_API void sha512(sha512_variant variant, const void *data, size_t len, uint8_t *digest);
+
+
+// Checks the known answers of every variant, prints the result, 0 when everything matched
+int sha512_self_test(void);
+#endif
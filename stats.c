@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STATS_HAVE_TSC 1
+#endif
+
+/*
+ * File Description : the counters behind --stats, one set per thread, linked on a list the first time
+ * a thread adds something, and the report printed at exit
+*/
+
+// what one thread did
+typedef struct Stats_counters {
+    uint64_t ns[STATS_PHASES];
+    uint64_t cycles[STATS_PHASES];
+    uint64_t bytes;
+    uint64_t blocks;
+    uint64_t messages;
+    struct Stats_counters *next;
+} stats_counters;
+
+#ifndef SHA_NO_STATS
+int stats_enabled = 0;
+#endif
+
+static stats_counters *all_counters;
+static size_t thread_count;
+static pthread_mutex_t counters_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread stats_counters *local;
+
+// the time stamp counter, 0 where there isn't one
+static uint64_t read_cycles(void){
+#ifdef STATS_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+stats_mark stats_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    stats_mark mark = { (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec, read_cycles() };
+    return mark;
+}
+
+// the counters of the calling thread, made the first time it needs them
+static stats_counters *thread_counters(void){
+    if(local == NULL){
+        local = calloc(1, sizeof(stats_counters));
+        if(local == NULL){
+            perror("calloc failed, in function thread_counters");
+            exit(1);
+        }
+        pthread_mutex_lock(&counters_lock);
+        local->next = all_counters;
+        all_counters = local;
+        thread_count++;
+        pthread_mutex_unlock(&counters_lock);
+    }
+    return local;
+}
+
+void stats_add_time(stats_phase phase, stats_mark start){
+    stats_counters *counters = thread_counters();
+    stats_mark end = stats_now();
+    counters->ns[phase] += end.ns - start.ns;
+    counters->cycles[phase] += end.cycles - start.cycles;
+}
+
+void stats_add_message(uint64_t bytes, uint64_t blocks){
+    stats_counters *counters = thread_counters();
+    counters->bytes += bytes;
+    counters->blocks += blocks;
+    counters->messages++;
+}
+
+#ifndef SHA_NO_STATS
+static const char *phase_names[STATS_PHASES] = { "read", "hash", "walk", "output" };
+static stats_format report_format;
+static stats_mark run_start;
+
+// ru_maxrss is in kilobytes on linux
+static long peak_rss_kb(void){
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0){
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+static void stats_report(void){
+    stats_mark end = stats_now();
+    double wall = (end.ns - run_start.ns) * 1e-9;
+
+    // the threads already finished, nothing is adding to the list anymore
+    stats_counters total = {0};
+    for(stats_counters *c = all_counters; c != NULL; c = c->next){
+        for(int p = 0; p < STATS_PHASES; ++p){
+            total.ns[p] += c->ns[p];
+            total.cycles[p] += c->cycles[p];
+        }
+        total.bytes += c->bytes;
+        total.blocks += c->blocks;
+        total.messages += c->messages;
+    }
+    double gb_per_s = wall > 0 ? total.bytes / wall / 1e9 : 0;
+    // only the hashing, the waiting for the data is on the read phase
+    double cycles_per_byte = total.bytes > 0 ? (double)total.cycles[STATS_HASH] / total.bytes : 0;
+    long rss = peak_rss_kb();
+
+    if(report_format == STATS_JSON){
+        fprintf(stderr, "{\"wall_seconds\": %.6f, \"messages\": %llu, \"bytes\": %llu, \"blocks\": %llu, "
+                        "\"gb_per_s\": %.3f, \"cycles_per_byte\": %.3f, \"peak_rss_kb\": %ld, \"phases\": {",
+                wall, (unsigned long long)total.messages, (unsigned long long)total.bytes,
+                (unsigned long long)total.blocks, gb_per_s, cycles_per_byte, rss);
+        for(int p = 0; p < STATS_PHASES; ++p){
+            fprintf(stderr, "%s\"%s\": {\"seconds\": %.6f, \"cycles\": %llu}", p ? ", " : "", phase_names[p],
+                    total.ns[p] * 1e-9, (unsigned long long)total.cycles[p]);
+        }
+        fprintf(stderr, "}, \"threads\": [");
+        size_t t = 0;
+        for(stats_counters *c = all_counters; c != NULL; c = c->next, ++t){
+            fprintf(stderr, "%s{\"bytes\": %llu, \"read_cycles\": %llu, \"hash_cycles\": %llu}", t ? ", " : "",
+                    (unsigned long long)c->bytes, (unsigned long long)c->cycles[STATS_READ],
+                    (unsigned long long)c->cycles[STATS_HASH]);
+        }
+        fprintf(stderr, "]}\n");
+        return;
+    }
+
+    fprintf(stderr, "stats: %.3f s, %llu messages, %llu bytes, %llu blocks\n", wall,
+            (unsigned long long)total.messages, (unsigned long long)total.bytes, (unsigned long long)total.blocks);
+    fprintf(stderr, "stats: %.3f GB/s, %.2f cycles/byte hashing\n", gb_per_s, cycles_per_byte);
+    // summed over the threads, so it can be more than the wall time
+    for(int p = 0; p < STATS_PHASES; ++p){
+        fprintf(stderr, "stats: %-6s %10.3f s %16llu cycles\n", phase_names[p], total.ns[p] * 1e-9,
+                (unsigned long long)total.cycles[p]);
+    }
+    if(thread_count > 1){
+        size_t t = 0;
+        for(stats_counters *c = all_counters; c != NULL; c = c->next, ++t){
+            fprintf(stderr, "stats: thread %zu %llu bytes, %llu read cycles, %llu hash cycles\n", t,
+                    (unsigned long long)c->bytes, (unsigned long long)c->cycles[STATS_READ],
+                    (unsigned long long)c->cycles[STATS_HASH]);
+        }
+    }
+    fprintf(stderr, "stats: peak rss %ld KB\n", rss);
+}
+#endif
+
+void stats_enable(stats_format format){
+#ifdef SHA_NO_STATS
+    (void)format;
+    fprintf(stderr, "built with SHA_NO_STATS, --stats does nothing\n");
+#else
+    // the last --stats given picks the format, the report is still one and times the run from the first
+    report_format = format;
+    static int registered = 0;
+    if(!registered){
+        registered = 1;
+        run_start = stats_now();
+        stats_enabled = 1;
+        atexit(stats_report);
+    }
+#endif
+}
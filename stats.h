@@ -0,0 +1,81 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+/*
+ * File Description : --stats, where the time of a run goes
+ * the timers wrap whole calls (a read, an update over a chunk, a getdents64) and never a single block,
+ * the block count comes from the message sizes, so the kernels have nothing in them
+ * every thread adds to its own counters, they're only summed for the report
+ * while stats_enabled is 0 each timer is a single branch that's never taken, and building with
+ * -DSHA_NO_STATS takes even that out
+*/
+
+// what the time is spent on
+typedef enum {
+    // waiting for the data: fread, pread, io_uring, opening and mapping the files
+    STATS_READ,
+    // the SHA updates and finals over the data already in memory
+    STATS_HASH,
+    // reading directories with -r
+    STATS_WALK,
+    // printing the results
+    STATS_OUTPUT,
+    STATS_PHASES,
+} stats_phase;
+
+typedef enum {
+    STATS_TEXT,
+    STATS_JSON,
+} stats_format;
+
+// when a timer started, both are 0 while the stats are off
+typedef struct Stats_mark {
+    uint64_t ns;
+    uint64_t cycles;
+} stats_mark;
+
+#ifdef SHA_NO_STATS
+#define stats_enabled 0
+#else
+extern int stats_enabled;
+#endif
+
+// Turns the counters on, the report goes to stderr when the program exits
+void stats_enable(stats_format format);
+// the slow parts, only called when the stats are on
+stats_mark stats_now(void);
+void stats_add_time(stats_phase phase, stats_mark start);
+void stats_add_message(uint64_t bytes, uint64_t blocks);
+
+static inline stats_mark stats_begin(void){
+    stats_mark mark = { 0, 0 };
+    if(__builtin_expect(stats_enabled, 0)){
+        mark = stats_now();
+    }
+    return mark;
+}
+
+static inline void stats_end(stats_phase phase, stats_mark start){
+    if(__builtin_expect(stats_enabled, 0)){
+        stats_add_time(phase, start);
+    }
+}
+
+// a message of bytes was hashed, the blocks are what the compression ran on, padding included
+static inline void stats_message(uint64_t bytes, uint64_t blocks){
+    if(__builtin_expect(stats_enabled, 0)){
+        stats_add_message(bytes, blocks);
+    }
+}
+
+// blocks of a hole message, with the 0x80 and the size: 9 bytes on SHA-256, 17 on SHA-512
+static inline uint64_t stats_sha256_blocks(uint64_t len){
+    return (len + 9 + 63) / 64;
+}
+
+static inline uint64_t stats_sha512_blocks(uint64_t len){
+    return (len + 17 + 127) / 128;
+}
+#endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "stream.h"
+#include "stats.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+ * File Description : the reader thread and the ring
+ * head counts the buffers the reader filled and tail the ones the hasher gave back, each side only writes
+ * its own counter, so there are no locks: a slot belongs to the reader while head - tail < STREAM_SLOTS
+ * and to the hasher after head moved past it. A side that finds nothing to do spins a little and then
+ * sleeps on the other side's counter with a futex, the other side only makes the wake syscall when
+ * someone is sleeping. The end of the stream is a buffer with nothing in it
+*/
+
+// pauses before going to sleep, a full buffer takes way longer than this to fill or hash
+#define STREAM_SPINS 256
+
+typedef struct Stream_slot {
+    uint8_t *data;
+    size_t len;
+} stream_slot;
+
+typedef struct Stream_ring {
+    stream_slot slots[STREAM_SLOTS];
+    // on their own cache lines, so each side's writes don't slow down the other side's reads
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t hasher_sleeping;
+    uint32_t tail __attribute__((aligned(64)));
+    uint32_t reader_sleeping;
+    int fd;
+    // set by the reader before it publishes the empty buffer
+    int failed;
+} stream_ring;
+
+// until *counter isn't seen anymore
+static void ring_wait(uint32_t *counter, uint32_t seen, uint32_t *sleeping){
+    for(int i = 0; i < STREAM_SPINS; ++i){
+        if(__atomic_load_n(counter, __ATOMIC_ACQUIRE) != seen){
+            return;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    // the flag goes up before the last look, and the other side moves the counter before looking at the flag,
+    // so either this sees the new value or the other side sees the flag
+    __atomic_store_n(sleeping, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(counter, __ATOMIC_SEQ_CST) == seen){
+#ifdef __linux__
+        // returns at once if the counter already moved
+        syscall(SYS_futex, counter, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+        sched_yield();
+#endif
+    }
+    __atomic_store_n(sleeping, 0, __ATOMIC_RELAXED);
+}
+
+// moves a counter forward, waking the other side if it's sleeping on it
+static void ring_advance(uint32_t *counter, uint32_t *sleeping){
+    __atomic_store_n(counter, *counter + 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(sleeping, __ATOMIC_SEQ_CST)){
+#ifdef __linux__
+        syscall(SYS_futex, counter, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+    }
+}
+
+// fills buf until it's full or the stream ends, -1 on errors
+static ssize_t stream_fill(int fd, uint8_t *buf, size_t size){
+    size_t done = 0;
+    while(done < size){
+        stats_mark mark = stats_begin();
+        ssize_t got = read(fd, &buf[done], size - done);
+        stats_end(STATS_READ, mark);
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got < 0){
+            return -1;
+        }
+        if(got == 0){
+            break;
+        }
+        done += (size_t)got;
+    }
+    return (ssize_t)done;
+}
+
+static void *stream_reader(void *arg){
+    stream_ring *ring = arg;
+    for(;;){
+        uint32_t head = ring->head;
+        uint32_t tail;
+        while(head - (tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) == STREAM_SLOTS){
+            ring_wait(&ring->tail, tail, &ring->reader_sleeping);
+        }
+        stream_slot *slot = &ring->slots[head % STREAM_SLOTS];
+        ssize_t got = stream_fill(ring->fd, slot->data, STREAM_BUFFER_SIZE);
+        if(got < 0){
+            perror("read failed, in function stream_reader");
+            ring->failed = 1;
+            got = 0;
+        }
+        slot->len = (size_t)got;
+        ring_advance(&ring->head, &ring->hasher_sleeping);
+        if(got == 0){
+            return NULL;
+        }
+    }
+}
+
+// a pipe holds 64K by default, a bigger one lets the writer get further ahead between two reads
+static void stream_grow_pipe(int fd){
+#if defined(__linux__) && defined(F_SETPIPE_SZ)
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)){
+        // the unprivileged limit is 1M, a failure only keeps the pipe as it was
+        fcntl(fd, F_SETPIPE_SZ, STREAM_BUFFER_SIZE);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+int stream_fd(int fd, stream_consume_fn consume, void *ctx){
+    stream_ring *ring = calloc(1, sizeof(stream_ring));
+    if(ring == NULL){
+        perror("calloc failed, in function stream_fd");
+        exit(1);
+    }
+    ring->fd = fd;
+    for(int i = 0; i < STREAM_SLOTS; ++i){
+        if(posix_memalign((void **)&ring->slots[i].data, STREAM_ALIGN, STREAM_BUFFER_SIZE) != 0){
+            perror("posix_memalign failed, in function stream_fd");
+            exit(1);
+        }
+    }
+    stream_grow_pipe(fd);
+
+    int result = 0;
+    pthread_t reader;
+    if(pthread_create(&reader, NULL, stream_reader, ring) != 0){
+        // without the thread the reading and the hashing just take turns on one buffer
+        for(;;){
+            ssize_t got = stream_fill(fd, ring->slots[0].data, STREAM_BUFFER_SIZE);
+            if(got < 0){
+                perror("read failed, in function stream_fd");
+                result = -1;
+            }
+            if(got <= 0){
+                break;
+            }
+            consume(ring->slots[0].data, (size_t)got, ctx);
+        }
+    }else{
+        for(;;){
+            uint32_t tail = ring->tail;
+            uint32_t head;
+            while((head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) == tail){
+                ring_wait(&ring->head, head, &ring->hasher_sleeping);
+            }
+            stream_slot *slot = &ring->slots[tail % STREAM_SLOTS];
+            if(slot->len == 0){
+                break;
+            }
+            consume(slot->data, slot->len, ctx);
+            ring_advance(&ring->tail, &ring->reader_sleeping);
+        }
+        pthread_join(reader, NULL);
+        result = ring->failed ? -1 : 0;
+    }
+
+    for(int i = 0; i < STREAM_SLOTS; ++i){
+        free(ring->slots[i].data);
+    }
+    free(ring);
+    return result;
+}
@@ -0,0 +1,27 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * File Description : reading a stream that can't be mapped (stdin, a pipe, a socket) while it's hashed
+ * a reader thread fills big aligned buffers and passes them through a single producer single consumer
+ * ring to the thread that hashes, so the program that writes the pipe (tar, zstd -d) never waits for the
+ * hashing and the memory stays at STREAM_SLOTS buffers whatever the size of the stream
+*/
+
+// each buffer is filled up to this before it's handed over
+#define STREAM_BUFFER_SIZE (1024 * 1024)
+// buffers on the ring, what the reader can be ahead of the hashing
+#define STREAM_SLOTS 8
+// page aligned, so the kernel copies whole pages into them
+#define STREAM_ALIGN 4096
+
+// what the hashing thread does with every buffer, in the order of the stream
+typedef void (*stream_consume_fn)(const uint8_t *data, size_t len, void *ctx);
+
+// Reads fd to the end on a reader thread, consume() runs on the calling thread, returns -1 on read errors
+// (everything read before the error was already consumed)
+int stream_fd(int fd, stream_consume_fn consume, void *ctx);
+#endif
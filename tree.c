@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tree.h"
+#include "sha256_mb.h"
+#include "pool.h"
+#include "stats.h"
+
+/*
+ * File Description : tree hash, the leaves are hashed in parallel on the pool, each worker reading its
+ * chunks with pread, then the levels are reduced with the multi buffer engine
+*/
+
+// what the leaf tasks share
+typedef struct Tree_job {
+    int fd;
+    uint64_t size;
+    size_t chunk_size;
+    uint8_t (*leaves)[SHA256_DIGEST_SIZE];
+    // set by any worker that fails to read
+    int failed;
+} tree_job;
+
+// hashes one chunk of the file into its leaf
+static void tree_leaf_task(size_t index, void *ctx){
+    tree_job *job = ctx;
+    uint64_t offset = (uint64_t)index * job->chunk_size;
+    size_t len = job->size - offset < job->chunk_size ? (size_t)(job->size - offset) : job->chunk_size;
+    // reading in smaller pieces, so the memory per worker doesn't grow with the chunk size
+    size_t piece_size = len < (1 << 20) ? len : (1 << 20);
+    uint8_t *piece = malloc(piece_size ? piece_size : 1);
+    if(piece == NULL){
+        perror("malloc failed, in function tree_leaf_task");
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    sha256_ctx ctx_leaf;
+    sha256_init(&ctx_leaf);
+    const uint8_t prefix = TREE_LEAF_PREFIX;
+    sha256_update(&ctx_leaf, &prefix, 1);
+
+    size_t done = 0;
+    while(done < len){
+        size_t want = len - done < piece_size ? len - done : piece_size;
+        stats_mark mark = stats_begin();
+        ssize_t got = pread(job->fd, piece, want, (off_t)(offset + done));
+        stats_end(STATS_READ, mark);
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got <= 0){
+            perror("pread failed, in function tree_leaf_task");
+            __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        mark = stats_begin();
+        sha256_update(&ctx_leaf, piece, (size_t)got);
+        stats_end(STATS_HASH, mark);
+        done += (size_t)got;
+    }
+    sha256_final(&ctx_leaf, job->leaves[index]);
+    stats_message(done + 1, stats_sha256_blocks(done + 1));
+    free(piece);
+}
+
+void tree_reduce(uint8_t (*levels)[SHA256_DIGEST_SIZE], size_t count, uint8_t root[SHA256_DIGEST_SIZE]){
+    size_t pairs_max = count / 2 + 1;
+    uint8_t (*nodes)[1 + 2 * SHA256_DIGEST_SIZE] = malloc(pairs_max * sizeof(*nodes));
+    const uint8_t **msgs = malloc(pairs_max * sizeof(uint8_t *));
+    size_t *lens = malloc(pairs_max * sizeof(size_t));
+    if(nodes == NULL || msgs == NULL || lens == NULL){
+        perror("malloc failed, in function tree_reduce");
+        exit(1);
+    }
+
+    while(count > 1){
+        size_t pairs = count / 2;
+        // 0x01 || left || right for every pair, all of them hashed together
+        for(size_t i = 0; i < pairs; ++i){
+            nodes[i][0] = TREE_NODE_PREFIX;
+            memcpy(&nodes[i][1], levels[2 * i], SHA256_DIGEST_SIZE);
+            memcpy(&nodes[i][1 + SHA256_DIGEST_SIZE], levels[2 * i + 1], SHA256_DIGEST_SIZE);
+            msgs[i] = nodes[i];
+            lens[i] = sizeof(nodes[i]);
+        }
+        sha256_mb_hash(msgs, lens, pairs, levels);
+        // the one without a pair goes up as it is
+        if(count % 2 == 1){
+            memcpy(levels[pairs], levels[count - 1], SHA256_DIGEST_SIZE);
+        }
+        count = pairs + count % 2;
+    }
+    memcpy(root, levels[0], SHA256_DIGEST_SIZE);
+
+    free(nodes);
+    free(msgs);
+    free(lens);
+}
+
+int tree_hash_file(const char *path, size_t chunk_size, int workers, uint8_t root[SHA256_DIGEST_SIZE]){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        fprintf(stderr, "ERROR OPENING FILE %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)){
+        fprintf(stderr, "%s: the tree hash only works on regular files\n", path);
+        close(fd);
+        return -1;
+    }
+
+    tree_job job = { .fd = fd, .size = (uint64_t)st.st_size, .chunk_size = chunk_size, .failed = 0 };
+    // an empty file still has one (empty) leaf
+    size_t leaves = job.size == 0 ? 1 : (size_t)((job.size + chunk_size - 1) / chunk_size);
+    job.leaves = malloc(leaves * SHA256_DIGEST_SIZE);
+    if(job.leaves == NULL){
+        perror("malloc failed, in function tree_hash_file");
+        close(fd);
+        return -1;
+    }
+
+    if(pool_run(workers, leaves, NULL, tree_leaf_task, &job) != 0){
+        job.failed = 1;
+    }
+    close(fd);
+
+    if(!job.failed){
+        tree_reduce(job.leaves, leaves, root);
+    }
+    free(job.leaves);
+    return job.failed ? -1 : 0;
+}
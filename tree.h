@@ -0,0 +1,28 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : tree hash mode, a Merkle tree of SHA-256 nodes over fixed size chunks of a file,
+ * so the chunks can be hashed on every core at the same time
+ *
+ * THIS IS NOT THE SHA-256 OF THE FILE, it's only comparable to another tree hash with the same chunk size:
+ *   leaf  = SHA256(0x00 || chunk)              chunks of chunk_size bytes, the last one can be shorter
+ *   node  = SHA256(0x01 || left || right)      the levels are paired from the left
+ *   a node without a pair goes up to the next level unchanged
+ *   an empty file has a single empty chunk
+ * the 0x00/0x01 prefixes keep a leaf from ever being taken for a node
+*/
+
+#define TREE_DEFAULT_CHUNK (1024 * 1024)
+#define TREE_LEAF_PREFIX 0x00
+#define TREE_NODE_PREFIX 0x01
+
+// Writes the root of the tree hash of the file, using workers threads for the leaves, -1 on errors
+int tree_hash_file(const char *path, size_t chunk_size, int workers, uint8_t root[SHA256_DIGEST_SIZE]);
+// Reduces count leaf digests to the root, levels[] is overwritten
+void tree_reduce(uint8_t (*levels)[SHA256_DIGEST_SIZE], size_t count, uint8_t root[SHA256_DIGEST_SIZE]);
+#endif
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uring.h"
+#include "stats.h"
+
+/*
+ * File Description : io_uring reader, talking to the kernel directly with the syscalls so there is no
+ * dependency on liburing
+ * every slot of the ring owns one registered buffer and one file, when a read completes the chunk goes
+ * to that file's context and the next read of the file is queued on the same slot, when the file ends
+ * the slot takes the next file of the list
+*/
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#define URING_SUPPORTED 1
+#endif
+
+// the size of each read, and of each registered buffer
+#define URING_CHUNK_SIZE (256 * 1024)
+#define URING_MAX_DEPTH 64
+
+#ifdef URING_SUPPORTED
+
+// the mapped rings, only the fields that are used
+typedef struct Uring {
+    int fd;
+    // submission ring
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    // completion ring
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    // kept to be unmapped
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+    unsigned to_submit;
+} uring_t;
+
+// one file being read
+typedef struct Uring_slot {
+    int fd;
+    // index of the path, -1 when the slot is free
+    long index;
+    uint64_t offset;
+    sha256_ctx ctx;
+} uring_slot;
+
+static int uring_setup(unsigned entries, struct io_uring_params *p){
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args){
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_close(uring_t *ring){
+    if(ring->sqes != NULL && ring->sqes != MAP_FAILED){
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if(ring->cq_ptr != NULL && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr){
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if(ring->sq_ptr != NULL && ring->sq_ptr != MAP_FAILED){
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    if(ring->fd >= 0){
+        close(ring->fd);
+    }
+}
+
+// creates the ring and maps the three regions the kernel shares with us
+static int uring_open(uring_t *ring, unsigned entries){
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(ring, 0, sizeof(*ring));
+
+    ring->fd = uring_setup(entries, &p);
+    if(ring->fd < 0){
+        return -1;
+    }
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    // newer kernels put both rings on the same mapping
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        if(ring->cq_size > ring->sq_size){
+            ring->sq_size = ring->cq_size;
+        }
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ptr == MAP_FAILED){
+        uring_close(ring);
+        return -1;
+    }
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        ring->cq_ptr = ring->sq_ptr;
+    }else{
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ptr == MAP_FAILED){
+            uring_close(ring);
+            return -1;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED){
+        uring_close(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ptr;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    char *cq = ring->cq_ptr;
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+// queues a read of the next chunk of the slot's file into the slot's registered buffer
+static void uring_queue_read(uring_t *ring, uring_slot *slot, unsigned slot_id, uint8_t *buffer){
+    unsigned tail = *ring->sq_tail;
+    unsigned i = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = slot->fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = URING_CHUNK_SIZE;
+    sqe->off = slot->offset;
+    sqe->buf_index = slot_id;
+    sqe->user_data = slot_id;
+
+    ring->sq_array[i] = i;
+    // the kernel only sees the entry after the tail moves
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+}
+
+int uring_available(void){
+    uring_t ring;
+    if(uring_open(&ring, 2) != 0){
+        return 0;
+    }
+    uring_close(&ring);
+    return 1;
+}
+
+// puts the next file that can be opened on the slot, returns 0 when there are no files left
+static int uring_slot_next(uring_slot *slot, const char *const *paths, size_t n, size_t *next,
+                           uring_done_fn done, void *ctx){
+    while(*next < n){
+        size_t index = (*next)++;
+        int fd = open(paths[index], O_RDONLY);
+        if(fd < 0){
+            fprintf(stderr, "ERROR OPENING FILE %s: %s\n", paths[index], strerror(errno));
+            done(index, -1, NULL, ctx);
+            continue;
+        }
+        slot->fd = fd;
+        slot->index = (long)index;
+        slot->offset = 0;
+        sha256_init(&slot->ctx);
+        return 1;
+    }
+    slot->index = -1;
+    return 0;
+}
+
+int uring_hash_files(const char *const *paths, size_t n, unsigned depth, uring_done_fn done, void *ctx){
+    if(depth < 1){
+        depth = 1;
+    }
+    if(depth > URING_MAX_DEPTH){
+        depth = URING_MAX_DEPTH;
+    }
+    if(depth > n){
+        depth = n ? (unsigned)n : 1;
+    }
+
+    uring_t ring;
+    if(uring_open(&ring, depth) != 0){
+        return -1;
+    }
+
+    // one contiguous allocation, split in depth registered buffers
+    uint8_t *buffers = NULL;
+    if(posix_memalign((void **)&buffers, 4096, (size_t)depth * URING_CHUNK_SIZE) != 0){
+        uring_close(&ring);
+        return -1;
+    }
+    struct iovec iov[URING_MAX_DEPTH];
+    for(unsigned i = 0; i < depth; ++i){
+        iov[i].iov_base = &buffers[(size_t)i * URING_CHUNK_SIZE];
+        iov[i].iov_len = URING_CHUNK_SIZE;
+    }
+    if(uring_register(ring.fd, IORING_REGISTER_BUFFERS, iov, depth) != 0){
+        free(buffers);
+        uring_close(&ring);
+        return -1;
+    }
+
+    uring_slot slots[URING_MAX_DEPTH];
+    size_t next = 0;
+    unsigned in_flight = 0;
+    for(unsigned i = 0; i < depth; ++i){
+        if(uring_slot_next(&slots[i], paths, n, &next, done, ctx)){
+            uring_queue_read(&ring, &slots[i], i, iov[i].iov_base);
+            in_flight++;
+        }
+    }
+
+    while(in_flight > 0){
+        // submits what was queued and waits for at least one completion
+        stats_mark mark = stats_begin();
+        int submitted = uring_enter(ring.fd, ring.to_submit, 1, IORING_ENTER_GETEVENTS);
+        stats_end(STATS_READ, mark);
+        if(submitted < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("io_uring_enter failed, in function uring_hash_files");
+            break;
+        }
+        ring.to_submit -= (unsigned)submitted;
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        mark = stats_begin();
+        for(; head != tail; ++head){
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            unsigned id = (unsigned)cqe->user_data;
+            int res = cqe->res;
+            uring_slot *slot = &slots[id];
+            in_flight--;
+
+            if(res == -EAGAIN || res == -EINTR){
+                // nothing was read, same chunk again
+            }else if(res > 0){
+                sha256_update(&slot->ctx, iov[id].iov_base, (size_t)res);
+                slot->offset += (uint64_t)res;
+            }else{
+                // res == 0 is the end of the file, negative is an error
+                uint8_t digest[SHA256_DIGEST_SIZE];
+                if(res == 0){
+                    sha256_final(&slot->ctx, digest);
+                    stats_message(slot->offset, stats_sha256_blocks(slot->offset));
+                    done((size_t)slot->index, 0, digest, ctx);
+                }else{
+                    fprintf(stderr, "read failed on %s: %s\n", paths[slot->index], strerror(-res));
+                    done((size_t)slot->index, -1, NULL, ctx);
+                }
+                close(slot->fd);
+                if(!uring_slot_next(slot, paths, n, &next, done, ctx)){
+                    continue;
+                }
+            }
+            uring_queue_read(&ring, slot, id, iov[id].iov_base);
+            in_flight++;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        // the completions are mostly hashing, the opens of the next files are in there too
+        stats_end(STATS_HASH, mark);
+    }
+
+    // in case the loop stopped because of an error, the files still open are reported as failed
+    for(unsigned i = 0; i < depth; ++i){
+        if(in_flight > 0 && slots[i].index >= 0){
+            close(slots[i].fd);
+            done((size_t)slots[i].index, -1, NULL, ctx);
+        }
+    }
+    while(next < n){
+        done(next++, -1, NULL, ctx);
+    }
+
+    uring_register(ring.fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+    free(buffers);
+    uring_close(&ring);
+    return 0;
+}
+
+#else
+
+int uring_available(void){
+    return 0;
+}
+
+int uring_hash_files(const char *const *paths, size_t n, unsigned depth, uring_done_fn done, void *ctx){
+    (void)paths;
+    (void)n;
+    (void)depth;
+    (void)done;
+    (void)ctx;
+    return -1;
+}
+#endif
@@ -0,0 +1,22 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : io_uring input backend, keeps the reads of many files in flight at the same time,
+ * on registered buffers, and hashes every chunk as soon as it arrives
+ * only available on linux, everything else (and old kernels) keep using stdio
+*/
+
+// called once per file, status is 0 when the digest is valid
+typedef void (*uring_done_fn)(size_t index, int status, const uint8_t digest[SHA256_DIGEST_SIZE], void *ctx);
+
+// 1 if the kernel lets us create a ring
+int uring_available(void);
+// Hashes every path, with up to depth files being read at once, done() is called as each one ends,
+// returns -1 if the ring couldn't be created (nothing was hashed then)
+int uring_hash_files(const char *const *paths, size_t n, unsigned depth, uring_done_fn done, void *ctx);
+#endif
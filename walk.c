@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "walk.h"
+#include "stats.h"
+
+/*
+ * File Description : parallel tree walk
+ * every worker has a deque of tasks, it pushes and pops at the back (depth first, so the paths it
+ * works on stay close) and the idle workers steal from the front (the oldest, usually the biggest
+ * directories), pending counts the tasks queued or running, the walk is over when it gets to 0
+ * a worker that finds nothing to steal sleeps on wake until a directory pushes more tasks or the walk ends
+ * the directories are read with getdents64 straight into a buffer, no readdir() per entry
+*/
+
+#define WALK_DENTS_SIZE (64 * 1024)
+
+// what getdents64 writes
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct Walk_task {
+    char *path;
+    int is_dir;
+    // the directory named on the command line, opened even when it's a symbolic link, like find -H
+    int is_root;
+} walk_task;
+
+typedef struct Walk_deque {
+    pthread_mutex_t lock;
+    walk_task *items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} walk_deque;
+
+// the files one worker hashed, joined at the end
+typedef struct Walk_results {
+    walk_entry *items;
+    size_t count;
+    size_t capacity;
+} walk_results;
+
+typedef struct Walk {
+    walk_deque *deques;
+    walk_results *results;
+    int workers;
+    size_t pending;
+    int failed;
+    walk_hash_fn hash;
+    void *ctx;
+    // the idle workers wait on wake, with idle_lock held while they look for work a last time
+    pthread_mutex_t idle_lock;
+    pthread_cond_t wake;
+} walk_t;
+
+typedef struct Walk_worker {
+    walk_t *walk;
+    int id;
+} walk_worker;
+
+static void deque_push(walk_deque *q, walk_task task){
+    pthread_mutex_lock(&q->lock);
+    if(q->tail >= q->capacity){
+        // moving the live part to the start before growing
+        size_t live = q->tail - q->head;
+        memmove(q->items, &q->items[q->head], live * sizeof(walk_task));
+        q->head = 0;
+        q->tail = live;
+        if(q->tail >= q->capacity){
+            q->capacity = q->capacity ? q->capacity * 2 : 64;
+            q->items = realloc(q->items, q->capacity * sizeof(walk_task));
+            if(q->items == NULL){
+                perror("REALLOC FAILED IN FUNCTION deque_push");
+                exit(1);
+            }
+        }
+    }
+    q->items[q->tail++] = task;
+    pthread_mutex_unlock(&q->lock);
+}
+
+// own work, from the back
+static int deque_pop(walk_deque *q, walk_task *task){
+    int found = 0;
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail){
+        *task = q->items[--q->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+// someone else's work, from the front
+static int deque_steal(walk_deque *q, walk_task *task){
+    int found = 0;
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail){
+        *task = q->items[q->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return found;
+}
+
+static void results_add(walk_results *r, char *path, const uint8_t digest[SHA256_DIGEST_SIZE], int status){
+    if(r->count >= r->capacity){
+        r->capacity = r->capacity ? r->capacity * 2 : 256;
+        r->items = realloc(r->items, r->capacity * sizeof(walk_entry));
+        if(r->items == NULL){
+            perror("REALLOC FAILED IN FUNCTION results_add");
+            exit(1);
+        }
+    }
+    walk_entry *e = &r->items[r->count++];
+    e->path = path;
+    e->status = status;
+    if(status == 0){
+        memcpy(e->digest, digest, SHA256_DIGEST_SIZE);
+    }
+}
+
+static char *join_path(const char *dir, const char *name){
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+    int slash = dir_len > 0 && dir[dir_len - 1] != '/';
+    char *path = malloc(dir_len + slash + name_len + 1);
+    if(path == NULL){
+        perror("malloc failed, in function join_path");
+        exit(1);
+    }
+    memcpy(path, dir, dir_len);
+    if(slash){
+        path[dir_len] = '/';
+    }
+    memcpy(&path[dir_len + slash], name, name_len + 1);
+    return path;
+}
+
+// wakes the idle workers, after new tasks were pushed or when the walk is over
+static void walk_wake(walk_t *walk){
+    pthread_mutex_lock(&walk->idle_lock);
+    pthread_cond_broadcast(&walk->wake);
+    pthread_mutex_unlock(&walk->idle_lock);
+}
+
+// reads one directory, every subdirectory and regular file becomes a task on the worker's deque
+static void walk_directory(walk_t *walk, int id, const char *path, int follow){
+    int fd = openat(AT_FDCWD, path, O_RDONLY | O_DIRECTORY | (follow ? 0 : O_NOFOLLOW) | O_CLOEXEC);
+    if(fd < 0){
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        __atomic_store_n(&walk->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    char *dents = malloc(WALK_DENTS_SIZE);
+    if(dents == NULL){
+        perror("malloc failed, in function walk_directory");
+        exit(1);
+    }
+    for(;;){
+        stats_mark mark = stats_begin();
+        long n = syscall(SYS_getdents64, fd, dents, WALK_DENTS_SIZE);
+        stats_end(STATS_WALK, mark);
+        if(n < 0){
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            __atomic_store_n(&walk->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        if(n == 0){
+            break;
+        }
+        int pushed = 0;
+        for(long off = 0; off < n;){
+            struct linux_dirent64 *d = (struct linux_dirent64 *)&dents[off];
+            off += d->d_reclen;
+            if(strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0){
+                continue;
+            }
+
+            unsigned char type = d->d_type;
+            // some filesystems don't fill the type
+            if(type == DT_UNKNOWN){
+                struct stat st;
+                if(fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0){
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN);
+            }
+            if(type != DT_DIR && type != DT_REG){
+                continue;
+            }
+
+            walk_task task = { join_path(path, d->d_name), type == DT_DIR, 0 };
+            __atomic_add_fetch(&walk->pending, 1, __ATOMIC_RELAXED);
+            deque_push(&walk->deques[id], task);
+            pushed = 1;
+        }
+        // once per getdents64 buffer, the others can start on these while the rest is read
+        if(pushed){
+            walk_wake(walk);
+        }
+    }
+    free(dents);
+    close(fd);
+}
+
+// own work first, then the others'
+static int walk_find(walk_t *walk, int id, walk_task *task){
+    int found = deque_pop(&walk->deques[id], task);
+    for(int i = 1; !found && i < walk->workers; ++i){
+        found = deque_steal(&walk->deques[(id + i) % walk->workers], task);
+    }
+    return found;
+}
+
+static void *walk_worker_main(void *arg){
+    walk_worker *self = arg;
+    walk_t *walk = self->walk;
+
+    for(;;){
+        walk_task task;
+        int found = walk_find(walk, self->id, &task);
+        if(!found){
+            // the others may still find more work, sleeping until they push it or the walk ends, the pushes
+            // finish before walk_wake() takes the lock, so a task pushed after this last look always wakes it
+            pthread_mutex_lock(&walk->idle_lock);
+            while(!(found = walk_find(walk, self->id, &task)) && __atomic_load_n(&walk->pending, __ATOMIC_ACQUIRE) > 0){
+                pthread_cond_wait(&walk->wake, &walk->idle_lock);
+            }
+            pthread_mutex_unlock(&walk->idle_lock);
+            if(!found){
+                break;
+            }
+        }
+
+        if(task.is_dir){
+            walk_directory(walk, self->id, task.path, task.is_root);
+            free(task.path);
+        }else{
+            uint8_t digest[SHA256_DIGEST_SIZE];
+            int status = walk->hash(task.path, digest, walk->ctx);
+            if(status != 0){
+                __atomic_store_n(&walk->failed, 1, __ATOMIC_RELAXED);
+            }
+            // the path now belongs to the results
+            results_add(&walk->results[self->id], task.path, digest, status);
+        }
+        // the children were counted before this one goes away, so pending only gets to 0 at the end
+        if(__atomic_sub_fetch(&walk->pending, 1, __ATOMIC_ACQ_REL) == 0){
+            walk_wake(walk);
+        }
+    }
+    return NULL;
+}
+
+static int compare_entries(const void *a, const void *b){
+    return strcmp(((const walk_entry *)a)->path, ((const walk_entry *)b)->path);
+}
+
+int walk_hash_tree(const char *root, int workers, walk_hash_fn hash, void *ctx, walk_entry **entries, size_t *count){
+    if(workers < 1){
+        workers = 1;
+    }
+    walk_t walk = { .workers = workers, .pending = 1, .failed = 0, .hash = hash, .ctx = ctx };
+    walk.deques = calloc(workers, sizeof(walk_deque));
+    walk.results = calloc(workers, sizeof(walk_results));
+    walk_worker *self = malloc(sizeof(walk_worker) * workers);
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    if(!walk.deques || !walk.results || !self || !threads){
+        perror("malloc failed, in function walk_hash_tree");
+        exit(1);
+    }
+    pthread_mutex_init(&walk.idle_lock, NULL);
+    pthread_cond_init(&walk.wake, NULL);
+    for(int i = 0; i < workers; ++i){
+        pthread_mutex_init(&walk.deques[i].lock, NULL);
+        self[i].walk = &walk;
+        self[i].id = i;
+    }
+
+    walk_task first = { join_path(root, ""), 1, 1 };
+    deque_push(&walk.deques[0], first);
+
+    // the calling thread is worker 0
+    int started = 1;
+    for(int i = 1; i < workers; ++i){
+        if(pthread_create(&threads[i], NULL, walk_worker_main, &self[i]) != 0){
+            perror("pthread_create failed, in function walk_hash_tree");
+            break;
+        }
+        started++;
+    }
+    walk_worker_main(&self[0]);
+    for(int i = 1; i < started; ++i){
+        pthread_join(threads[i], NULL);
+    }
+
+    // joining the results of every worker, sorted so the output doesn't depend on the scheduling
+    size_t total = 0;
+    for(int i = 0; i < workers; ++i){
+        total += walk.results[i].count;
+    }
+    walk_entry *all = malloc(sizeof(walk_entry) * (total ? total : 1));
+    if(all == NULL){
+        perror("malloc failed, in function walk_hash_tree");
+        exit(1);
+    }
+    size_t at = 0;
+    for(int i = 0; i < workers; ++i){
+        memcpy(&all[at], walk.results[i].items, walk.results[i].count * sizeof(walk_entry));
+        at += walk.results[i].count;
+        free(walk.results[i].items);
+        free(walk.deques[i].items);
+        pthread_mutex_destroy(&walk.deques[i].lock);
+    }
+    qsort(all, total, sizeof(walk_entry), compare_entries);
+    pthread_mutex_destroy(&walk.idle_lock);
+    pthread_cond_destroy(&walk.wake);
+
+    free(walk.deques);
+    free(walk.results);
+    free(self);
+    free(threads);
+
+    *entries = all;
+    *count = total;
+    return walk.failed ? -1 : 0;
+}
+
+void walk_tree_digest(const char *root, const walk_entry *entries, size_t count, uint8_t digest[SHA256_DIGEST_SIZE]){
+    // the paths on the entries all start with root and a '/', that part is left out
+    size_t skip = strlen(root);
+    if(skip > 0 && root[skip - 1] != '/'){
+        skip++;
+    }
+
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    for(size_t i = 0; i < count; ++i){
+        if(entries[i].status != 0){
+            continue;
+        }
+        char hex[2 * SHA256_DIGEST_SIZE + 1];
+        sha256_hex(entries[i].digest, hex);
+        sha256_update(&ctx, hex, 2 * SHA256_DIGEST_SIZE);
+        sha256_update(&ctx, "  ", 2);
+        sha256_update(&ctx, &entries[i].path[skip], strlen(&entries[i].path[skip]));
+        sha256_update(&ctx, "\n", 1);
+    }
+    sha256_final(&ctx, digest);
+}
+
+void walk_free(walk_entry *entries, size_t count){
+    for(size_t i = 0; i < count; ++i){
+        free(entries[i].path);
+    }
+    free(entries);
+}
@@ -0,0 +1,32 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+/*
+ * File Description : recursive directory hashing, the directories are read by every worker at the same
+ * time (the directories and the files found are tasks on work stealing queues), and each file is hashed
+ * as soon as it's found, so the traversal and the hashing overlap
+ * symbolic links found on the walk aren't followed, the same as find, a root that is one is (like find -H)
+*/
+
+// hashes one file, the callback decides how it's read (mmap, cache...), 0 when the digest is valid
+typedef int (*walk_hash_fn)(const char *path, uint8_t digest[SHA256_DIGEST_SIZE], void *ctx);
+
+// a file found on the tree
+typedef struct Walk_entry {
+    char *path;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    int status;
+} walk_entry;
+
+// Walks root with workers threads, entries gets every regular file sorted by path, -1 on errors
+// (the entries that could be hashed are still returned)
+int walk_hash_tree(const char *root, int workers, walk_hash_fn hash, void *ctx, walk_entry **entries, size_t *count);
+// The deterministic digest of a tree, SHA-256 of the sorted "<hex>  <path relative to root>\n" lines
+void walk_tree_digest(const char *root, const walk_entry *entries, size_t count, uint8_t digest[SHA256_DIGEST_SIZE]);
+// Frees what walk_hash_tree returned
+void walk_free(walk_entry *entries, size_t count);
+#endif